@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#include "matrix.h"
+#include "cpu_features.h"
+
+// Ядро: acc[j] = max(acc[j], rows[i * stride + j]) для i < nrows, j < width.
+template<typename T>
+using ColumnMaxKernel = void (*)(T* acc, const T* rows, size_t stride, size_t nrows, size_t width);
+
+// Рядки обробляються блоками, щоб акумулятори блоку стовпців
+// жили в регістрах, а не перечитувались з пам'яті на кожному рядку.
+constexpr size_t COLMAX_ROW_BLOCK = 64;
+
+// Ширина тайла стовпців: ціла кількість кеш-ліній, а блок рядків
+// тайла разом з акумуляторами займає не більше половини кешу.
+template<typename T>
+size_t columnTileWidth(size_t cacheBytes) {
+    constexpr size_t perLine = CACHE_LINE / sizeof(T);
+    size_t width = cacheBytes / 2 / (sizeof(T) * (COLMAX_ROW_BLOCK + 1));
+    return std::max(perLine, width / perLine * perLine);
+}
+
+template<typename T>
+void columnMaxScalar(T* acc, const T* rows, size_t stride, size_t nrows, size_t width) {
+    for (size_t i = 0; i < nrows; ++i) {
+        const T* r = rows + i * stride;
+        for (size_t j = 0; j < width; ++j)
+            acc[j] = std::max(acc[j], r[j]);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+template<typename T>
+TARGET_SSE41 inline __m128i max128(__m128i a, __m128i b) {
+    if constexpr (std::is_signed_v<T>) return _mm_max_epi32(a, b);
+    else return _mm_max_epu32(a, b);
+}
+
+template<typename T>
+TARGET_AVX2 inline __m256i max256(__m256i a, __m256i b) {
+    if constexpr (std::is_signed_v<T>) return _mm256_max_epi32(a, b);
+    else return _mm256_max_epu32(a, b);
+}
+
+template<typename T>
+TARGET_AVX512 inline __m512i max512(__m512i a, __m512i b) {
+    // Маскована форма: безмасковані _mm512_max_* у GCC 12 дають хибне -Wmaybe-uninitialized.
+    if constexpr (std::is_signed_v<T>) return _mm512_mask_max_epi32(a, __mmask16(0xFFFF), a, b);
+    else return _mm512_mask_max_epu32(a, __mmask16(0xFFFF), a, b);
+}
+
+template<typename T>
+TARGET_SSE41 void columnMaxSse41(T* acc, const T* rows, size_t stride, size_t nrows, size_t width) {
+    for (size_t r0 = 0; r0 < nrows; r0 += COLMAX_ROW_BLOCK) {
+        size_t r1 = std::min(nrows, r0 + COLMAX_ROW_BLOCK);
+        size_t j = 0;
+        for (; j + 16 <= width; j += 16) {
+            __m128i m0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + j));
+            __m128i m1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + j + 4));
+            __m128i m2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + j + 8));
+            __m128i m3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + j + 12));
+            for (size_t i = r0; i < r1; ++i) {
+                const T* r = rows + i * stride + j;
+                m0 = max128<T>(m0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r)));
+                m1 = max128<T>(m1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + 4)));
+                m2 = max128<T>(m2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + 8)));
+                m3 = max128<T>(m3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + 12)));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + j), m0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + j + 4), m1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + j + 8), m2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + j + 12), m3);
+        }
+        for (; j + 4 <= width; j += 4) {
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + j));
+            for (size_t i = r0; i < r1; ++i)
+                m = max128<T>(m, _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + i * stride + j)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + j), m);
+        }
+        if (j < width)
+            columnMaxScalar(acc + j, rows + r0 * stride + j, stride, r1 - r0, width - j);
+    }
+}
+
+template<typename T>
+TARGET_AVX2 void columnMaxAvx2(T* acc, const T* rows, size_t stride, size_t nrows, size_t width) {
+    for (size_t r0 = 0; r0 < nrows; r0 += COLMAX_ROW_BLOCK) {
+        size_t r1 = std::min(nrows, r0 + COLMAX_ROW_BLOCK);
+        size_t j = 0;
+        for (; j + 32 <= width; j += 32) {
+            __m256i m0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + j));
+            __m256i m1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + j + 8));
+            __m256i m2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + j + 16));
+            __m256i m3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + j + 24));
+            for (size_t i = r0; i < r1; ++i) {
+                const T* r = rows + i * stride + j;
+                m0 = max256<T>(m0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r)));
+                m1 = max256<T>(m1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + 8)));
+                m2 = max256<T>(m2, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + 16)));
+                m3 = max256<T>(m3, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + 24)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + j), m0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + j + 8), m1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + j + 16), m2);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + j + 24), m3);
+        }
+        for (; j + 8 <= width; j += 8) {
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + j));
+            for (size_t i = r0; i < r1; ++i)
+                m = max256<T>(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + i * stride + j)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + j), m);
+        }
+        if (j < width)
+            columnMaxScalar(acc + j, rows + r0 * stride + j, stride, r1 - r0, width - j);
+    }
+}
+
+template<typename T>
+TARGET_AVX512 void columnMaxAvx512(T* acc, const T* rows, size_t stride, size_t nrows, size_t width) {
+    for (size_t r0 = 0; r0 < nrows; r0 += COLMAX_ROW_BLOCK) {
+        size_t r1 = std::min(nrows, r0 + COLMAX_ROW_BLOCK);
+        size_t j = 0;
+        for (; j + 64 <= width; j += 64) {
+            __m512i m0 = _mm512_loadu_si512(acc + j);
+            __m512i m1 = _mm512_loadu_si512(acc + j + 16);
+            __m512i m2 = _mm512_loadu_si512(acc + j + 32);
+            __m512i m3 = _mm512_loadu_si512(acc + j + 48);
+            for (size_t i = r0; i < r1; ++i) {
+                const T* r = rows + i * stride + j;
+                m0 = max512<T>(m0, _mm512_loadu_si512(r));
+                m1 = max512<T>(m1, _mm512_loadu_si512(r + 16));
+                m2 = max512<T>(m2, _mm512_loadu_si512(r + 32));
+                m3 = max512<T>(m3, _mm512_loadu_si512(r + 48));
+            }
+            _mm512_storeu_si512(acc + j, m0);
+            _mm512_storeu_si512(acc + j + 16, m1);
+            _mm512_storeu_si512(acc + j + 32, m2);
+            _mm512_storeu_si512(acc + j + 48, m3);
+        }
+        for (; j < width; j += 16) {
+            __mmask16 k = width - j >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << (width - j)) - 1);
+            __m512i m = _mm512_maskz_loadu_epi32(k, acc + j);
+            for (size_t i = r0; i < r1; ++i)
+                m = max512<T>(m, _mm512_maskz_loadu_epi32(k, rows + i * stride + j));
+            _mm512_mask_storeu_epi32(acc + j, k, m);
+        }
+    }
+}
+
+#endif
+
+// Варіант ядра для конкретного набору інструкцій; для непідтримуваних
+// типів або архітектур повертається скалярний варіант.
+template<typename T>
+ColumnMaxKernel<T> columnMaxKernel(Isa isa) {
+#ifdef HAVE_X86_SIMD
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+        switch (isa) {
+            case Isa::AVX512: return columnMaxAvx512<T>;
+            case Isa::AVX2:   return columnMaxAvx2<T>;
+            case Isa::SSE41:  return columnMaxSse41<T>;
+            default: break;
+        }
+    }
+#endif
+    (void)isa;
+    return columnMaxScalar<T>;
+}
+
+// Найшвидший варіант для поточного процесора, обирається при першому виклику.
+template<typename T>
+ColumnMaxKernel<T> columnMaxKernel() {
+    static const ColumnMaxKernel<T> kernel = columnMaxKernel<T>(detectIsa());
+    return kernel;
+}
+
+// Потокова редукція максимуму по стовпцях [colBegin, colEnd):
+// рядки проходяться послідовно, acc[j - colBegin] тримає поточний максимум.
+// acc має бути заповнений першим рядком діапазону або мінімальним значенням.
+template<typename T>
+void columnMaxRows(const Matrix<T>& mat, size_t rowBegin, size_t rowEnd,
+                   size_t colBegin, size_t colEnd, T* acc) {
+    if (rowBegin >= rowEnd || colBegin >= colEnd) return;
+    columnMaxKernel<T>()(acc, mat.row(rowBegin) + colBegin, mat.stride(),
+                         rowEnd - rowBegin, colEnd - colBegin);
+}
+
+// Максимум кожного стовпця смуги [colBegin, colEnd) по всіх рядках.
+template<typename T>
+void columnMaxStrip(const Matrix<T>& mat, size_t colBegin, size_t colEnd, T* acc) {
+    if (mat.rows() == 0 || colBegin >= colEnd) return;
+    std::memcpy(acc, mat.row(0) + colBegin, (colEnd - colBegin) * sizeof(T));
+    columnMaxRows(mat, 1, mat.rows(), colBegin, colEnd, acc);
+}
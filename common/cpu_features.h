@@ -0,0 +1,76 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(HAVE_X86_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE41  __attribute__((target("sse4.1")))
+#define TARGET_AVX2   __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+// Набори інструкцій, для яких є окремі варіанти ядер.
+enum class Isa { Scalar, SSE41, AVX2, AVX512 };
+
+inline const char* isaName(Isa isa) {
+    switch (isa) {
+        case Isa::SSE41:  return "SSE4.1";
+        case Isa::AVX2:   return "AVX2";
+        case Isa::AVX512: return "AVX-512";
+        default:          return "scalar";
+    }
+}
+
+#if defined(HAVE_X86_SIMD) && defined(_MSC_VER) && !defined(__clang__)
+inline Isa detectIsaImpl() {
+    int r[4];
+    __cpuid(r, 0);
+    int maxLeaf = r[0];
+    __cpuid(r, 1);
+    bool sse41 = r[2] & (1 << 19);
+    bool osxsave = r[2] & (1 << 27);
+    bool avx = r[2] & (1 << 28);
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymm = (xcr0 & 0x6) == 0x6;
+    bool zmm = (xcr0 & 0xE6) == 0xE6;
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(r, 7, 0);
+        avx2 = avx && ymm && (r[1] & (1 << 5));
+        avx512 = zmm && (r[1] & (1 << 16));
+    }
+    if (avx512) return Isa::AVX512;
+    if (avx2) return Isa::AVX2;
+    if (sse41) return Isa::SSE41;
+    return Isa::Scalar;
+}
+#elif defined(HAVE_X86_SIMD)
+inline Isa detectIsaImpl() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+    if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return Isa::SSE41;
+    return Isa::Scalar;
+}
+#else
+inline Isa detectIsaImpl() { return Isa::Scalar; }
+#endif
+
+// Найкращий набір інструкцій поточного процесора (визначається один раз).
+inline Isa detectIsa() {
+    static const Isa isa = detectIsaImpl();
+    return isa;
+}
+
+inline bool isaSupported(Isa isa) {
+    return static_cast<int>(isa) <= static_cast<int>(detectIsa());
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <algorithm>
+
+#include "cpu_features.h"
+
+// Фільтр + редукція без розгалужень: op(acc, pred(x) ? x : Op::identity).
+// Pred і Op — типи з однаковим інтерфейсом для скалярного й AVX2-шляху,
+// тож інші дільники й операції отримують ту саму векторизацію.
+
+// x % D == 0 без ділення (Lemire, "Faster Remainder by Direct Computation"):
+// для D = d * 2^k з непарним d — x * d^-1 mod 2^32, циклічно зсунуте на k,
+// не перевищує (2^32 - 1) / D. Перевіряється |x|, тож від'ємні кратні
+// теж проходять; |INT_MIN| = 2^31 як беззнакове.
+template<uint32_t D>
+struct divisible_by {
+    static_assert(D > 0, "Дільник має бути додатним");
+
+    static constexpr uint32_t shift() {
+        uint32_t k = 0;
+        while (!((D >> k) & 1)) ++k;
+        return k;
+    }
+
+    static constexpr uint32_t inverse() {
+        uint32_t d = D >> shift();
+        uint32_t x = d;              // d * d == 1 (mod 8)
+        for (int i = 0; i < 5; ++i)  // Ньютон подвоює кількість правильних бітів
+            x *= 2 - d * x;
+        return x;
+    }
+
+    static constexpr uint32_t K = shift();
+    static constexpr uint32_t INV = inverse();
+    static constexpr uint32_t LIMIT = UINT32_MAX / D;
+
+    static bool test(int x) {
+        uint32_t ux = static_cast<uint32_t>(x);
+        uint32_t p = (x < 0 ? 0u - ux : ux) * INV;
+        if constexpr (K != 0) p = (p >> K) | (p << (32 - K));
+        return p <= LIMIT;
+    }
+
+#ifdef HAVE_X86_SIMD
+    // Маска з усіма одиницями в лініях, що діляться на D.
+    static TARGET_AVX2 __m256i mask(__m256i x) {
+        __m256i p = _mm256_mullo_epi32(_mm256_abs_epi32(x), _mm256_set1_epi32(static_cast<int>(INV)));
+        if constexpr (K != 0)
+            p = _mm256_or_si256(_mm256_srli_epi32(p, K), _mm256_slli_epi32(p, 32 - K));
+        // беззнакове p <= LIMIT  <=>  min(p, LIMIT) == p
+        __m256i limit = _mm256_set1_epi32(static_cast<int>(LIMIT));
+        return _mm256_cmpeq_epi32(_mm256_min_epu32(p, limit), p);
+    }
+#endif
+};
+
+struct xor_op {
+    static constexpr int identity = 0;
+    static int apply(int a, int b) { return a ^ b; }
+#ifdef HAVE_X86_SIMD
+    static TARGET_AVX2 __m256i apply(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+#endif
+};
+
+struct sum_op {
+    static constexpr int identity = 0;
+    static int apply(int a, int b) {
+        return static_cast<int>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+    }
+#ifdef HAVE_X86_SIMD
+    static TARGET_AVX2 __m256i apply(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+#endif
+};
+
+struct or_op {
+    static constexpr int identity = 0;
+    static int apply(int a, int b) { return a | b; }
+#ifdef HAVE_X86_SIMD
+    static TARGET_AVX2 __m256i apply(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+#endif
+};
+
+struct min_op {
+    static constexpr int identity = INT_MAX;
+    static int apply(int a, int b) { return std::min(a, b); }
+#ifdef HAVE_X86_SIMD
+    static TARGET_AVX2 __m256i apply(__m256i a, __m256i b) { return _mm256_min_epi32(a, b); }
+#endif
+};
+
+template<typename Pred, typename Op>
+int filter_reduce_scalar(const int* data, size_t n, int acc = Op::identity) {
+    for (size_t i = 0; i < n; ++i)
+        acc = Op::apply(acc, Pred::test(data[i]) ? data[i] : Op::identity);
+    return acc;
+}
+
+#ifdef HAVE_X86_SIMD
+template<typename Pred, typename Op>
+TARGET_AVX2 int filter_reduce_avx2(const int* data, size_t n, int acc = Op::identity) {
+    const __m256i id = _mm256_set1_epi32(Op::identity);
+    __m256i a0 = id, a1 = id, a2 = id, a3 = id;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 8));
+        __m256i x2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 16));
+        __m256i x3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 24));
+        a0 = Op::apply(a0, _mm256_blendv_epi8(id, x0, Pred::mask(x0)));
+        a1 = Op::apply(a1, _mm256_blendv_epi8(id, x1, Pred::mask(x1)));
+        a2 = Op::apply(a2, _mm256_blendv_epi8(id, x2, Pred::mask(x2)));
+        a3 = Op::apply(a3, _mm256_blendv_epi8(id, x3, Pred::mask(x3)));
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        a0 = Op::apply(a0, _mm256_blendv_epi8(id, x, Pred::mask(x)));
+    }
+    __m256i a = Op::apply(Op::apply(a0, a1), Op::apply(a2, a3));
+
+    alignas(32) int lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), a);
+    for (int lane : lanes) acc = Op::apply(acc, lane);
+    return filter_reduce_scalar<Pred, Op>(data + i, n - i, acc);
+}
+#endif
+
+// Обирає AVX2-варіант, якщо процесор його підтримує.
+template<typename Pred, typename Op>
+int filter_reduce(const int* data, size_t n, int acc = Op::identity) {
+#ifdef HAVE_X86_SIMD
+    if (isaSupported(Isa::AVX2)) return filter_reduce_avx2<Pred, Op>(data, n, acc);
+#endif
+    return filter_reduce_scalar<Pred, Op>(data, n, acc);
+}
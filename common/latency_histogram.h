@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Гістограма затримок у наносекундах у стилі HdrHistogram: кожна степінь
+// двійки ділиться на 32 рівні кошики, тож відносна похибка не перевищує
+// 1/32 (~3%). Запис — кілька арифметичних операцій і relaxed-запис,
+// без блокувань і виділень пам'яті. Читання збирає знімок, який можна
+// об'єднувати з іншими (наприклад, з гістограмами інших потоків).
+class latency_histogram {
+public:
+    static constexpr int SUB_BITS = 5;
+    static constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS;
+    static constexpr int MAX_MSB = 45;   // до 2^46 нс (~19 годин); більші значення обрізаються
+    static constexpr size_t BUCKETS = (MAX_MSB - SUB_BITS + 2) * SUB_COUNT;
+
+    static size_t bucket_of(uint64_t v) {
+        if (v < SUB_COUNT) return static_cast<size_t>(v);
+        int msb = 63 - count_leading_zeros(v);
+        if (msb > MAX_MSB) return BUCKETS - 1;
+        int shift = msb - SUB_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_COUNT + ((v >> shift) - SUB_COUNT));
+    }
+
+    // Нижня межа й ширина кошика.
+    static uint64_t bucket_low(size_t i) {
+        if (i < SUB_COUNT) return i;
+        size_t shift = i / SUB_COUNT - 1;
+        return (SUB_COUNT + i % SUB_COUNT) << shift;
+    }
+    static uint64_t bucket_width(size_t i) {
+        return i < SUB_COUNT ? 1 : uint64_t(1) << (i / SUB_COUNT - 1);
+    }
+
+    // Лише для гістограми з одним записувачем: звичайні load/store
+    // замість атомарних RMW-інструкцій.
+    void record(uint64_t ns) {
+        auto& c = counts[bucket_of(ns)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total.store(total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    }
+
+    // Для гістограми, у яку пишуть кілька потоків.
+    void record_concurrent(uint64_t ns) {
+        counts[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    struct snapshot {
+        std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS);
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+
+        snapshot& merge(const snapshot& o) {
+            for (size_t i = 0; i < BUCKETS; ++i) counts[i] += o.counts[i];
+            count += o.count;
+            sum_ns += o.sum_ns;
+            return *this;
+        }
+
+        // Значення, не менше за частку q записів (середина кошика).
+        double percentile_ns(double q) const {
+            if (count == 0) return 0;
+            uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += counts[i];
+                if (seen >= target) return bucket_low(i) + (bucket_width(i) - 1) / 2.0;
+            }
+            return 0;
+        }
+
+        double min_ns() const {
+            for (size_t i = 0; i < BUCKETS; ++i)
+                if (counts[i]) return static_cast<double>(bucket_low(i));
+            return 0;
+        }
+
+        double max_ns() const {
+            for (size_t i = BUCKETS; i-- > 0;)
+                if (counts[i]) return static_cast<double>(bucket_low(i) + bucket_width(i) - 1);
+            return 0;
+        }
+
+        double mean_ns() const { return count ? static_cast<double>(sum_ns) / count : 0; }
+    };
+
+    // Знімок не атомарний щодо одночасних записів, але кожен кошик
+    // прочитано цілим; для звітів цього достатньо.
+    snapshot read() const {
+        snapshot s;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            s.counts[i] = counts[i].load(std::memory_order_relaxed);
+            s.count += s.counts[i];
+        }
+        s.sum_ns = total.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    static int count_leading_zeros(uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long idx;
+        _BitScanReverse64(&idx, v);
+        return 63 - static_cast<int>(idx);
+#else
+        return __builtin_clzll(v);
+#endif
+    }
+
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Файл, відображений у пам'ять лише для читання. Сторінки підвантажує ОС
+// під час доступу, тож розмір файлу може перевищувати обсяг RAM.
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Не вдалося відкрити " + path);
+        LARGE_INTEGER len;
+        if (!GetFileSizeEx(file, &len)) {
+            CloseHandle(file);
+            throw std::runtime_error("Не вдалося отримати розмір " + path);
+        }
+        length = static_cast<size_t>(len.QuadPart);
+        if (length == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            throw std::runtime_error("Не вдалося відобразити " + path);
+        }
+        ptr = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!ptr) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            throw std::runtime_error("Не вдалося відобразити " + path);
+        }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Не вдалося відкрити " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Не вдалося отримати розмір " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length == 0) return;
+        void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Не вдалося відобразити " + path);
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+        ptr = static_cast<const char*>(p);
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (ptr) munmap(const_cast<char*>(ptr), length);
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    const char* data() const { return ptr; }
+    size_t size() const { return length; }
+
+    // Дескриптор відкритого файлу, наприклад для sendfile/TransmitFile.
+#ifdef _WIN32
+    HANDLE native_handle() const { return file; }
+#else
+    int native_handle() const { return fd; }
+#endif
+
+private:
+    const char* ptr = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
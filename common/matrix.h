@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// Розмір кеш-лінії; рядки матриці вирівнюються на цю межу.
+constexpr size_t CACHE_LINE = 64;
+
+// Щільна row-major матриця з одним виділенням пам'яті.
+// Кожен рядок доповнюється до кратного CACHE_LINE, тож початок
+// будь-якого рядка вирівняний на 64 байти.
+template<typename T>
+class Matrix {
+public:
+    class ColumnView {
+    public:
+        ColumnView(const T* base, size_t stride, size_t size): base(base), stride(stride), n(size) {}
+        const T& operator[](size_t i) const { return base[i * stride]; }
+        size_t size() const { return n; }
+    private:
+        const T* base;
+        size_t stride;
+        size_t n;
+    };
+
+    Matrix() = default;
+
+    Matrix(size_t rows, size_t cols): rowsN(rows), colsN(cols), strideN(paddedStride(cols)) {
+        if (rowsN && colsN) {
+            // Розміри можуть прийти з мережі: rows*stride*sizeof(T) не має переповнити size_t.
+            if (strideN < colsN || strideN > SIZE_MAX / sizeof(T) / rowsN)
+                throw std::bad_array_new_length();
+            ptr = static_cast<T*>(::operator new(rowsN * strideN * sizeof(T), std::align_val_t(CACHE_LINE)));
+        }
+    }
+
+    Matrix(const Matrix& other): Matrix(other.rowsN, other.colsN) {
+        if (ptr) std::memcpy(ptr, other.ptr, rowsN * strideN * sizeof(T));
+    }
+
+    Matrix(Matrix&& other) noexcept { swap(other); }
+
+    Matrix& operator=(Matrix other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~Matrix() {
+        if (ptr) ::operator delete(ptr, std::align_val_t(CACHE_LINE));
+    }
+
+    void swap(Matrix& other) noexcept {
+        std::swap(ptr, other.ptr);
+        std::swap(rowsN, other.rowsN);
+        std::swap(colsN, other.colsN);
+        std::swap(strideN, other.strideN);
+    }
+
+    size_t rows() const { return rowsN; }
+    size_t cols() const { return colsN; }
+    size_t stride() const { return strideN; }
+
+    // Обсяг корисних даних (без доповнення рядків).
+    size_t bytes() const { return rowsN * colsN * sizeof(T); }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+
+    T* row(size_t i) { return ptr + i * strideN; }
+    const T* row(size_t i) const { return ptr + i * strideN; }
+
+    ColumnView col(size_t j) const { return ColumnView(ptr + j, strideN, rowsN); }
+
+    T& operator()(size_t i, size_t j) { return ptr[i * strideN + j]; }
+    const T& operator()(size_t i, size_t j) const { return ptr[i * strideN + j]; }
+
+private:
+    static size_t paddedStride(size_t cols) {
+        constexpr size_t perLine = CACHE_LINE / sizeof(T) ? CACHE_LINE / sizeof(T) : 1;
+        return (cols + perLine - 1) / perLine * perLine;
+    }
+
+    T* ptr = nullptr;
+    size_t rowsN = 0, colsN = 0, strideN = 0;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+// Спільний шар сокетів: Winsock на Windows, BSD-сокети деінде.
+// Надає ті самі імена (SOCKET, INVALID_SOCKET, closesocket), тож код
+// лабораторних не потребує #ifdef навколо кожного виклику.
+
+#include <stdexcept>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+inline int net_error() { return WSAGetLastError(); }
+inline bool net_would_block() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+
+inline bool set_nonblocking(SOCKET s) {
+    u_long on = 1;
+    return ioctlsocket(s, FIONBIO, &on) == 0;
+}
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <csignal>
+#include <cerrno>
+
+using SOCKET = int;
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+
+inline int closesocket(SOCKET s) { return ::close(s); }
+inline int net_error() { return errno; }
+inline bool net_would_block() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+inline bool set_nonblocking(SOCKET s) {
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+
+// Обмеження очікування в блокуючому recv; після нього recv повертає помилку.
+inline bool set_recv_timeout(SOCKET s, std::chrono::milliseconds timeout) {
+#ifdef _WIN32
+    DWORD ms = static_cast<DWORD>(timeout.count());
+    return setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms)) == 0;
+#else
+    timeval tv{};
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+    return setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+#endif
+}
+
+// Ініціалізація мережі на час життя об'єкта: WSAStartup/WSACleanup на
+// Windows; на POSIX — ігнорування SIGPIPE, щоб запис у закритий сокет
+// повертав помилку замість завершення процесу.
+class socket_runtime {
+public:
+    socket_runtime() {
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) throw std::runtime_error("WSAStartup не вдався");
+#else
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+    }
+
+    socket_runtime(const socket_runtime&) = delete;
+    socket_runtime& operator=(const socket_runtime&) = delete;
+
+    ~socket_runtime() {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+};
+
+struct net_buffer {
+    const char* data;
+    size_t size;
+};
+
+// Блокуюча відправка кількох буферів одним викликом на пачку (writev /
+// WSASend) з дозаписом після часткової відправки. Масив bufs змінюється.
+inline bool send_gather(SOCKET s, net_buffer* bufs, size_t n) {
+    constexpr size_t BATCH = 64;
+    while (n) {
+        size_t k = std::min(n, BATCH);
+#ifdef _WIN32
+        WSABUF wb[BATCH];
+        for (size_t i = 0; i < k; ++i) {
+            wb[i].buf = const_cast<char*>(bufs[i].data);
+            wb[i].len = static_cast<ULONG>(bufs[i].size);
+        }
+        DWORD sent = 0;
+        if (WSASend(s, wb, static_cast<DWORD>(k), &sent, 0, nullptr, nullptr) != 0) return false;
+        size_t left = sent;
+#else
+        iovec iov[BATCH];
+        for (size_t i = 0; i < k; ++i) {
+            iov[i].iov_base = const_cast<char*>(bufs[i].data);
+            iov[i].iov_len = bufs[i].size;
+        }
+        ssize_t sent = writev(s, iov, static_cast<int>(k));
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        size_t left = static_cast<size_t>(sent);
+#endif
+        while (n && left >= bufs->size) {
+            left -= bufs->size;
+            ++bufs;
+            --n;
+        }
+        if (n) {
+            bufs->data += left;
+            bufs->size -= left;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <utility>
+
+#include "thread_pool.h"
+#include "topology.h"
+
+// Лічильник незавершених частин одного виклику parallel_for.
+class fork_join_latch {
+public:
+    explicit fork_join_latch(size_t count): remaining(count) {}
+
+    void count_down() {
+        std::lock_guard<std::mutex> lk(m);
+        if (--remaining == 0) cv.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lk(m);
+        cv.wait(lk, [&]{ return remaining == 0; });
+    }
+
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    size_t remaining;
+};
+
+// Межі k-ї з parts майже рівних частин діапазону [0, n).
+inline std::pair<size_t, size_t> split_range(size_t n, size_t parts, size_t k) {
+    size_t base = n / parts, rem = n % parts;
+    size_t begin = k * base + std::min(k, rem);
+    return {begin, begin + base + (k < rem ? 1 : 0)};
+}
+
+// Fork-join поверх thread_pool: потоки створюються один раз і
+// перевикористовуються між викликами parallel_for.
+class fork_join_executor {
+public:
+    // pin = true закріплює робочі потоки за логічними процесорами,
+    // спершу по одному на фізичне ядро (див. CpuTopology::cpuOrder).
+    explicit fork_join_executor(size_t workers = std::thread::hardware_concurrency(), bool pin = false)
+        : pool(std::max<size_t>(workers, 1), std::max<size_t>(workers, 1) * 4,
+               pin ? pinToTopology : std::function<void(size_t)>()) {}
+
+    size_t workers() const { return pool.size(); }
+
+    // Викликає fn(b, e) для частин [begin, end) розміром grain і чекає
+    // на завершення всіх частин. Перша частина виконується в потоці, що
+    // викликав; частини, які не вмістилися в чергу пулу, теж.
+    template<typename F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F&& fn) {
+        if (begin >= end) return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (end - begin + grain - 1) / grain;
+        if (chunks == 1) {
+            fn(begin, end);
+            return;
+        }
+
+        fork_join_latch latch(chunks - 1);
+        for (size_t c = 1; c < chunks; ++c) {
+            size_t b = begin + c * grain;
+            size_t e = std::min(end, b + grain);
+            bool queued = pool.addTask([&fn, &latch, b, e] {
+                fn(b, e);
+                latch.count_down();
+            });
+            if (!queued) {
+                fn(b, e);
+                latch.count_down();
+            }
+        }
+        fn(begin, std::min(end, begin + grain));
+        latch.wait();
+    }
+
+    // Викликає fn(worker, workers) рівно один раз у кожному робочому потоці.
+    // Потрібно, коли частина даних має належати конкретному потоку
+    // (first-touch розміщення сторінок на його NUMA-вузлі).
+    template<typename F>
+    void for_each_worker(F&& fn) {
+        std::lock_guard<std::mutex> serial(for_each_m);
+        size_t n = pool.size();
+        // Задача чекає, поки стартують усі n задач, тож жоден потік не візьме дві.
+        fork_join_latch started(n), finished(n);
+        for (size_t k = 0; k < n; ++k) {
+            while (!pool.addTask([&fn, &started, &finished, n] {
+                started.count_down();
+                started.wait();
+                fn(thread_pool::worker_index(), n);
+                finished.count_down();
+            })) std::this_thread::yield();
+        }
+        finished.wait();
+    }
+
+private:
+    static void pinToTopology(size_t index) {
+        const auto& order = cpuTopology().cpuOrder;
+        if (!order.empty()) pinCurrentThread(order[index % order.size()]);
+    }
+
+    thread_pool pool;
+    std::mutex for_each_m;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#include "matrix.h"
+#include "cpu_features.h"
+#include "parallel_for.h"
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// Лічильниковий генератор: результат залежить лише від (key, counter),
+// тож будь-який елемент матриці можна згенерувати незалежно від інших.
+struct Philox4x32 {
+    uint32_t v[4];
+
+    static Philox4x32 generate(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint64_t key) {
+        uint32_t k0 = static_cast<uint32_t>(key), k1 = static_cast<uint32_t>(key >> 32);
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = uint64_t(0xD2511F53u) * c0;
+            uint64_t p1 = uint64_t(0xCD9E8D57u) * c2;
+            uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            c1 = static_cast<uint32_t>(p1);
+            c3 = static_cast<uint32_t>(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return {{c0, c1, c2, c3}};
+    }
+};
+
+// x -> floor(x * range / 2^32): рівномірне відображення в [0, range) без ділення.
+inline void boundedScalar(uint32_t* data, size_t n, uint32_t range) {
+    for (size_t i = 0; i < n; ++i)
+        data[i] = static_cast<uint32_t>((uint64_t(data[i]) * range) >> 32);
+}
+
+#ifdef HAVE_X86_SIMD
+TARGET_AVX2 inline void boundedAvx2(uint32_t* data, size_t n, uint32_t range) {
+    const __m256i r = _mm256_set1_epi32(static_cast<int>(range));
+    const __m256i hiMask = _mm256_set1_epi64x(static_cast<long long>(0xFFFFFFFF00000000ull));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, r), 32);
+        __m256i odd = _mm256_and_si256(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), r), hiMask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_or_si256(even, odd));
+    }
+    boundedScalar(data + i, n - i, range);
+}
+#endif
+
+inline void boundedRange(uint32_t* data, size_t n, uint32_t range) {
+#ifdef HAVE_X86_SIMD
+    if (isaSupported(Isa::AVX2)) {
+        boundedAvx2(data, n, range);
+        return;
+    }
+#endif
+    boundedScalar(data, n, range);
+}
+
+// Заповнює рядки [rowBegin, rowEnd) значеннями з [0, range).
+// Елемент (i, j) береться з блоку Philox з лічильником (j / 4, i).
+template<typename T>
+void fillRandomRows(Matrix<T>& mat, uint64_t seed, uint32_t range, size_t rowBegin, size_t rowEnd) {
+    static_assert(sizeof(T) == sizeof(uint32_t), "Генератор заповнює 32-бітні елементи");
+    size_t cols = mat.cols();
+    for (size_t i = rowBegin; i < rowEnd; ++i) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(mat.row(i));
+        for (size_t j = 0; j < cols; j += 4) {
+            Philox4x32 block = Philox4x32::generate(static_cast<uint32_t>(j / 4), static_cast<uint32_t>(i),
+                                                    0, 0, seed);
+            size_t count = std::min<size_t>(4, cols - j);
+            std::copy(block.v, block.v + count, row + j);
+        }
+        boundedRange(row, cols, range);
+    }
+}
+
+// Паралельне заповнення; результат однаковий за будь-якої кількості потоків.
+template<typename T>
+void fillRandomMatrix(Matrix<T>& mat, uint64_t seed, uint32_t range, fork_join_executor& pool) {
+    size_t grain = std::max<size_t>(1, mat.rows() / (pool.workers() * 4));
+    pool.parallel_for(0, mat.rows(), grain, [&](size_t r0, size_t r1) {
+        fillRandomRows(mat, seed, range, r0, r1);
+    });
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Компактні кодування рядка uint32_t для передачі мережею. Кожен рядок
+// кодується окремо й займає фіксовану кількість байтів, тож приймач
+// розкодовує рядки, щойно вони надійшли, не чекаючи решти матриці.
+enum class RowEncoding : uint32_t {
+    U32 = 0,      // як є
+    U16 = 1,      // значення < 65536, два байти little-endian
+    BitPack = 2,  // bits бітів на значення, потік бітів від молодших
+};
+
+// Найменша кількість бітів, що вміщує maxValue (щонайменше 1).
+inline uint32_t bitsFor(uint32_t maxValue) {
+    uint32_t bits = 1;
+    while (bits < 32 && (maxValue >> bits)) ++bits;
+    return bits;
+}
+
+inline size_t encodedRowBytes(RowEncoding enc, size_t n, uint32_t bits) {
+    switch (enc) {
+    case RowEncoding::U16:     return n * sizeof(uint16_t);
+    case RowEncoding::BitPack: return (n * bits + 7) / 8;
+    default:                   return n * sizeof(uint32_t);
+    }
+}
+
+inline void packRow(const uint32_t* in, size_t n, uint32_t bits, uint8_t* out) {
+    uint64_t acc = 0;
+    uint32_t filled = 0;
+    for (size_t i = 0; i < n; ++i) {
+        acc |= uint64_t(in[i]) << filled;
+        filled += bits;
+        while (filled >= 8) {
+            *out++ = static_cast<uint8_t>(acc);
+            acc >>= 8;
+            filled -= 8;
+        }
+    }
+    if (filled) *out = static_cast<uint8_t>(acc);
+}
+
+inline void unpackRow(const uint8_t* in, size_t n, uint32_t bits, uint32_t* out) {
+    const uint64_t mask = (uint64_t(1) << bits) - 1;
+    uint64_t acc = 0;
+    uint32_t filled = 0;
+    for (size_t i = 0; i < n; ++i) {
+        while (filled < bits) {
+            acc |= uint64_t(*in++) << filled;
+            filled += 8;
+        }
+        out[i] = static_cast<uint32_t>(acc & mask);
+        acc >>= bits;
+        filled -= bits;
+    }
+}
+
+inline void encodeRow(RowEncoding enc, const uint32_t* in, size_t n, uint32_t bits, uint8_t* out) {
+    switch (enc) {
+    case RowEncoding::U16:
+        for (size_t i = 0; i < n; ++i) {
+            out[2 * i] = static_cast<uint8_t>(in[i]);
+            out[2 * i + 1] = static_cast<uint8_t>(in[i] >> 8);
+        }
+        break;
+    case RowEncoding::BitPack:
+        packRow(in, n, bits, out);
+        break;
+    default:
+        std::memcpy(out, in, n * sizeof(uint32_t));
+        break;
+    }
+}
+
+inline void decodeRow(RowEncoding enc, const uint8_t* in, size_t n, uint32_t bits, uint32_t* out) {
+    switch (enc) {
+    case RowEncoding::U16:
+        for (size_t i = 0; i < n; ++i) out[i] = in[2 * i] | (uint32_t(in[2 * i + 1]) << 8);
+        break;
+    case RowEncoding::BitPack:
+        unpackRow(in, n, bits, out);
+        break;
+    default:
+        std::memcpy(out, in, n * sizeof(uint32_t));
+        break;
+    }
+}
@@ -0,0 +1,1081 @@
+#pragma once
+
+#include <iostream>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <climits>
+#include <memory>
+#include <random>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <iterator>
+#include <fstream>
+#include <string>
+
+#include "unique_function.h"
+#include "latency_histogram.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+using read_write_lock = std::shared_mutex;
+using read_lock = std::shared_lock<read_write_lock>;
+using write_lock = std::unique_lock<read_write_lock>;
+
+template<typename F>
+class task_queue {
+    std::queue<F> tasks;
+    mutable read_write_lock rw;
+public:
+    bool empty() const {
+        read_lock lk(rw);
+        return tasks.empty();
+    }
+
+    size_t size() const {
+        read_lock lk(rw);
+        return tasks.size();
+    }
+
+    void clear() {
+        write_lock lk(rw);
+        while (!tasks.empty()) tasks.pop();
+    }
+
+    bool pop(F &f) {
+        write_lock lk(rw);
+        if (tasks.empty()) return false;
+        f = std::move(tasks.front()); tasks.pop();
+        return true;
+    }
+
+    bool push(F&& f, size_t cap) {
+        write_lock lk(rw);
+        if (tasks.size() >= cap) return false;
+        tasks.push(std::move(f));
+        return true;
+    }
+
+    // Перша задача в черзі (std::queue не має top(), лише front()).
+    F top() const {
+        read_lock lk(rw);
+        if (tasks.empty()) throw std::runtime_error("Черга пуста");
+        return tasks.front();
+    }
+};
+
+// Обмежена lock-free черга багатьох виробників і споживачів (Д. Вюков).
+// Кожна комірка має лічильник послідовності: виробник чекає seq == pos,
+// споживач — seq == pos + 1, тож позиції захоплюються одним CAS.
+template<typename F>
+class mpmc_queue {
+    struct alignas(64) cell {
+        std::atomic<size_t> seq;
+        F value;
+    };
+
+    static size_t round_up(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+public:
+    explicit mpmc_queue(size_t capacity)
+        : mask(round_up(capacity) - 1), cells(new cell[mask + 1]) {
+        for (size_t i = 0; i <= mask; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        size_t tail = dequeue_pos.load(std::memory_order_acquire);
+        size_t head = enqueue_pos.load(std::memory_order_acquire);
+        return head > tail ? head - tail : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Відмовляє, якщо в черзі вже cap задач (або кільце заповнене).
+    bool push(F&& f, size_t cap) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            // Прочитане dequeue_pos не новіше за справжнє, тож оцінка
+            // розміру не менша за реальну і cap не буде перевищено. Але pos
+            // теж може застаріти: якщо споживачі вже пішли далі, різниця
+            // стала б від'ємною, тож спершу перечитуємо pos.
+            size_t head = dequeue_pos.load(std::memory_order_acquire);
+            if (head > pos) {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (pos - head >= cap) return false;
+            cell& c = cells[pos & mask];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = std::move(f);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Кладе до n елементів підряд одним CAS і повертає, скільки вмістилося.
+    // Елементи, що не вмістилися, лишаються в items недоторканими.
+    size_t push_bulk(F* items, size_t n, size_t cap) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (n) {
+            size_t head = dequeue_pos.load(std::memory_order_acquire);
+            if (head > pos) {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (pos - head >= cap) return 0;
+            size_t want = std::min(n, cap - (pos - head));
+            // Комірка вільна для позиції p, якщо її seq == p; лише власник
+            // позиції p може її змінити, тож перевірка до CAS лишається чинною.
+            size_t fit = 0;
+            while (fit < want && cells[(pos + fit) & mask].seq.load(std::memory_order_acquire) == pos + fit)
+                ++fit;
+            if (fit == 0) {
+                intptr_t diff = static_cast<intptr_t>(cells[pos & mask].seq.load(std::memory_order_acquire))
+                              - static_cast<intptr_t>(pos);
+                if (diff < 0) return 0;
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (enqueue_pos.compare_exchange_weak(pos, pos + fit, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < fit; ++i) {
+                    cell& c = cells[(pos + i) & mask];
+                    c.value = std::move(items[i]);
+                    c.seq.store(pos + i + 1, std::memory_order_release);
+                }
+                return fit;
+            }
+        }
+        return 0;
+    }
+
+    bool pop(F& f) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell& c = cells[pos & mask];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    f = std::move(c.value);
+                    c.value = F();
+                    c.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    const size_t mask;
+    std::unique_ptr<cell[]> cells;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+};
+
+#ifdef __linux__
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+inline void futex_wait_for(std::atomic<uint32_t>& word, uint32_t expected, Clock::duration timeout) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    timespec ts{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+}
+inline void futex_wake(std::atomic<uint32_t>& word, bool all) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+}
+#else
+// C++20 atomic::wait: WaitOnAddress на Windows, futex/ulock деінде.
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected) {
+    word.wait(expected, std::memory_order_acquire);
+}
+// atomic::wait не має тайм-ауту, тож чекаємо короткими кроками;
+// виклики в циклі самі перевіряють дедлайн.
+inline void futex_wait_for(std::atomic<uint32_t>& word, uint32_t expected, Clock::duration timeout) {
+    if (word.load(std::memory_order_acquire) == expected)
+        std::this_thread::sleep_for(std::min<Clock::duration>(timeout, std::chrono::microseconds(200)));
+}
+inline void futex_wake(std::atomic<uint32_t>& word, bool all) {
+    if (all) word.notify_all();
+    else word.notify_one();
+}
+#endif
+
+// Eventcount: потік, що засинає, запам'ятовує епоху, ще раз перевіряє умову
+// і спить на futex, доки епоха не зміниться. notify_one будить рівно одного.
+class event_count {
+public:
+    uint32_t prepare_wait() {
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        uint32_t key = epoch.load(std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return key;
+    }
+
+    void cancel_wait() { waiters.fetch_sub(1, std::memory_order_relaxed); }
+
+    void wait(uint32_t key) {
+        while (epoch.load(std::memory_order_acquire) == key)
+            futex_wait(epoch, key);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Повертає false, якщо дедлайн настав раніше за сповіщення.
+    bool wait_until(uint32_t key, Clock::time_point deadline) {
+        if (deadline == Clock::time_point::max()) {
+            wait(key);
+            return true;
+        }
+        while (epoch.load(std::memory_order_acquire) == key) {
+            auto now = Clock::now();
+            if (now >= deadline) {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            futex_wait_for(epoch, key, deadline - now);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void notify_one() { notify(false); }
+    void notify_all() { notify(true); }
+
+private:
+    void notify(bool all) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) return;
+        epoch.fetch_add(1, std::memory_order_release);
+        futex_wake(epoch, all);
+    }
+
+    alignas(64) std::atomic<uint32_t> epoch{0};
+    alignas(64) std::atomic<uint32_t> waiters{0};
+};
+
+// Спільний стан задачі, поданої через submit: один блок на задачу замість
+// std::promise + його shared_state. Два посилання — у future та у задачі.
+template<typename T>
+class future_state {
+public:
+    template<typename F>
+    void run(F& f) {
+        try {
+            if constexpr (std::is_void_v<T>) f();
+            else value.emplace(f());
+        } catch (...) {
+            error = std::current_exception();
+        }
+        publish();
+    }
+
+    void fail(std::exception_ptr e) {
+        error = std::move(e);
+        publish();
+    }
+
+    bool ready() const { return status.load(std::memory_order_acquire) == DONE; }
+
+    void wait() {
+        uint32_t s = status.load(std::memory_order_acquire);
+        while (s != DONE) {
+            if (s == PENDING && !status.compare_exchange_weak(s, WAITED, std::memory_order_acquire))
+                continue;
+            futex_wait(status, WAITED);
+            s = status.load(std::memory_order_acquire);
+        }
+    }
+
+    bool wait_until(Clock::time_point deadline) {
+        uint32_t s = status.load(std::memory_order_acquire);
+        while (s != DONE) {
+            auto now = Clock::now();
+            if (now >= deadline) return false;
+            if (s == PENDING && !status.compare_exchange_weak(s, WAITED, std::memory_order_acquire))
+                continue;
+            futex_wait_for(status, WAITED, deadline - now);
+            s = status.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    T take() {
+        if (error) std::rethrow_exception(error);
+        if constexpr (!std::is_void_v<T>) return std::move(*value);
+    }
+
+    void release() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+private:
+    static constexpr uint32_t PENDING = 0, WAITED = 1, DONE = 2;
+
+    void publish() {
+        if (status.exchange(DONE, std::memory_order_release) == WAITED)
+            futex_wake(status, true);
+    }
+
+    std::atomic<uint32_t> refs{2};
+    std::atomic<uint32_t> status{PENDING};
+    std::exception_ptr error;
+    std::optional<std::conditional_t<std::is_void_v<T>, char, T>> value;
+};
+
+// Результат submit. get() чекає на завершення задачі й повертає її
+// результат або перекидає виняток (зокрема, якщо задачу відкинув пул).
+template<typename T>
+class task_future {
+public:
+    task_future() = default;
+    explicit task_future(future_state<T>* st): state(st) {}
+    task_future(task_future&& o) noexcept : state(std::exchange(o.state, nullptr)) {}
+    task_future& operator=(task_future&& o) noexcept {
+        if (this != &o) {
+            if (state) state->release();
+            state = std::exchange(o.state, nullptr);
+        }
+        return *this;
+    }
+    task_future(const task_future&) = delete;
+    task_future& operator=(const task_future&) = delete;
+    ~task_future() { if (state) state->release(); }
+
+    bool valid() const { return state != nullptr; }
+    bool ready() const { return state->ready(); }
+    void wait() const { state->wait(); }
+
+    template<typename Rep, typename Period>
+    bool wait_for(std::chrono::duration<Rep, Period> timeout) const {
+        return state->wait_until(Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout));
+    }
+
+    T get() {
+        state->wait();
+        future_state<T>* st = std::exchange(state, nullptr);
+        struct releaser { future_state<T>* s; ~releaser() { s->release(); } } guard{st};
+        return st->take();
+    }
+
+private:
+    future_state<T>* state = nullptr;
+};
+
+// Замикання задачі з submit. Якщо його знищено, не викликавши
+// (черга відкинула задачу), future отримує виняток замість вічного очікування.
+template<typename F, typename T>
+class packaged_call {
+public:
+    template<typename G>
+    packaged_call(G&& f, future_state<T>* st): fn(std::forward<G>(f)), state(st) {}
+    packaged_call(packaged_call&& o) noexcept(std::is_nothrow_move_constructible_v<F>)
+        : fn(std::move(o.fn)), state(std::exchange(o.state, nullptr)) {}
+    packaged_call(const packaged_call&) = delete;
+
+    ~packaged_call() {
+        if (state) {
+            state->fail(std::make_exception_ptr(std::runtime_error("Задачу відкинуто: черга заповнена або термін минув")));
+            state->release();
+        }
+    }
+
+    void operator()() {
+        future_state<T>* st = std::exchange(state, nullptr);
+        st->run(fn);
+        st->release();
+    }
+
+private:
+    F fn;
+    future_state<T>* state;
+};
+
+// Дек Чейза-Лева (Lê et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models"): власник кладе й бере з низу без CAS, крадії забирають
+// зверху. Фіксованої місткості; у разі переповнення push повертає false.
+template<typename T>
+class ws_deque {
+public:
+    explicit ws_deque(size_t capacity = 1024)
+        : mask(capacity - 1), buffer(new std::atomic<T*>[capacity]) {}
+
+    bool empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+    // Лише потік-власник.
+    bool push(T* x) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(mask)) return false;
+        buffer[b & mask].store(x, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Лише потік-власник.
+    T* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* x = buffer[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                x = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // Будь-який потік.
+    T* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+        T* x = buffer[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return x;
+    }
+
+private:
+    const size_t mask;
+    std::unique_ptr<std::atomic<T*>[]> buffer;
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+};
+
+// shared_queue: усі потоки беруть задачі зі спільних смуг черги.
+// work_stealing: задачі, додані з робочого потоку, йдуть у його власний дек;
+// потік без роботи краде з деків випадкових інших потоків.
+enum class pool_mode { shared_queue, work_stealing };
+
+// Що робити, коли спільна черга заповнена: відкинути задачу, чекати на
+// місце без обмеження або чекати не довше заданого тайм-ауту.
+enum class overflow_policy { reject, block, block_for };
+
+using task_fn = unique_function<void()>;
+
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Пріоритет визначає смугу черги: потоки спершу вибирають задачі з
+// critical, потім normal, потім batch. Усередині смуги — FIFO.
+enum class task_priority : uint8_t { critical, normal, batch };
+
+// deadline — момент, після якого задачу вже немає сенсу виконувати:
+// прострочену задачу потік відкидає, не запускаючи.
+struct task_options {
+    task_priority priority = task_priority::normal;
+    Clock::time_point deadline = Clock::time_point::max();
+};
+
+// Задача в черзі разом із моментом подання (для гістограм затримок)
+// і терміном виконання.
+struct queued_task {
+    task_fn fn;
+    int64_t enqueued_ns = 0;
+    int64_t deadline_ns = INT64_MAX;
+
+    queued_task() = default;
+    queued_task(task_fn&& f, int64_t at, int64_t deadline = INT64_MAX)
+        : fn(std::move(f)), enqueued_ns(at), deadline_ns(deadline) {}
+};
+
+enum class metrics_format { prometheus, json };
+
+// Межі адаптивного пулу: потік додається, коли черга заповнена довше
+// за grow_after, і завершується, коли простояв без задач retire_after.
+struct elastic_bounds {
+    size_t min_workers;
+    size_t max_workers;
+    Clock::duration grow_after = std::chrono::milliseconds(500);
+    Clock::duration retire_after = std::chrono::seconds(5);
+};
+
+class thread_pool {
+public:
+    // on_start викликається в кожному робочому потоці з його номером
+    // перед обробкою задач (наприклад, для закріплення за ядром).
+    thread_pool(size_t workers = 6, size_t capacity = 15, std::function<void(size_t)> on_start = nullptr,
+                pool_mode mode = pool_mode::shared_queue)
+        : thread_pool(elastic_bounds{workers, workers}, capacity, std::move(on_start), mode) {}
+
+    // Адаптивний пул: стартує з min_workers потоків і змінює їх кількість
+    // у межах [min_workers, max_workers].
+    thread_pool(const elastic_bounds& bounds, size_t capacity, std::function<void(size_t)> on_start = nullptr,
+                pool_mode mode = pool_mode::shared_queue)
+        : MIN_WORKERS(std::max<size_t>(bounds.min_workers, 1)),
+          MAX_WORKERS(std::max(bounds.max_workers, MIN_WORKERS)),
+          CAP(capacity), MODE(mode), GROW_AFTER(bounds.grow_after), RETIRE_AFTER(bounds.retire_after),
+          on_start(std::move(on_start)),
+          slab(std::min<size_t>(capacity, 4096) + (mode == pool_mode::work_stealing ? MAX_WORKERS * 1024 : 0)),
+          workers_vec(MAX_WORKERS), started_at(Clock::now()) {
+        if (MAX_WORKERS > INT32_MAX) throw std::runtime_error("Забагато робочих потоків");
+        for (auto& lane : lanes) lane = std::make_unique<mpmc_queue<queued_task>>(capacity);
+        for(size_t i = 0; i < MAX_WORKERS; ++i)
+            states.push_back(std::make_unique<worker_state>());
+        std::lock_guard<std::mutex> lk(scale_mtx);
+        for(size_t i = 0; i < MIN_WORKERS; ++i)
+            spawn_locked();
+    }
+    ~thread_pool() { shutdown(); }
+
+    // Кількість робочих потоків, що працюють зараз.
+    size_t size() const { return active.load(std::memory_order_acquire); }
+    bool elastic() const { return MIN_WORKERS != MAX_WORKERS; }
+
+    // Номер робочого потоку, в якому виконується виклик, або SIZE_MAX поза пулом.
+    static size_t worker_index() { return current_worker; }
+
+    // Повертає false, якщо черга заповнена і задачу відкинуто.
+    // У режимі work_stealing задачі зі звичайними параметрами з робочих
+    // потоків цього пулу потрапляють у їхні деки й не обмежуються CAP.
+    // Замикання стирається до task_fn лише тут; великі кладуться в slab пулу.
+    template<typename F>
+    bool addTask(F&& f, const task_options& opts = {}) {
+        int64_t now = now_ns();
+        bool plain = opts.priority == task_priority::normal && opts.deadline == Clock::time_point::max();
+        if (MODE == pool_mode::work_stealing && current_pool == this && plain) {
+            queued_task* node = slab.make<queued_task>(task_fn(std::forward<F>(f), &slab), now);
+            if (states[current_worker]->deque.push(node)) {
+                // Рахується так само, як задача зі спільної черги.
+                attempted++;
+                accepted++;
+                idle.notify_one();
+                return true;
+            }
+            return enqueue(std::move(*node), node, lane_of(opts, now));
+        }
+        return enqueue(queued_task(task_fn(std::forward<F>(f), &slab), now, deadline_of(opts)), nullptr,
+                       lane_of(opts, now));
+    }
+
+    // Як addTask, але повертає task_future з результатом f().
+    // Відкинута або прострочена задача завершує future винятком.
+    template<typename F, typename R = std::invoke_result_t<std::decay_t<F>&>>
+    task_future<R> submit(F&& f, const task_options& opts = {}) {
+        auto* st = new future_state<R>();
+        task_future<R> fut(st);
+        addTask(packaged_call<std::decay_t<F>, R>(std::forward<F>(f), st), opts);
+        return fut;
+    }
+
+    // Подає всі задачі з [first, last) (елементи переміщуються) і будить
+    // потоки один раз. Поки є місце, задачі кладуться в чергу одним CAS на пачку.
+    template<typename It,
+             typename F = typename std::iterator_traits<It>::value_type,
+             typename R = std::invoke_result_t<F&>>
+    std::vector<task_future<R>> submit_bulk(It first, It last, const task_options& opts = {}) {
+        std::vector<task_future<R>> futures;
+        std::vector<queued_task> tasks;
+        int64_t at = now_ns(), deadline = deadline_of(opts);
+        for (; first != last; ++first) {
+            auto* st = new future_state<R>();
+            futures.emplace_back(st);
+            tasks.emplace_back(task_fn(packaged_call<F, R>(std::move(*first), st), &slab), at, deadline);
+        }
+
+        size_t n = tasks.size();
+        attempted += n;
+        size_t pushed = push_tasks(tasks.data(), n, lane_of(opts, at));
+        accepted += pushed;
+        rejected += n - pushed;
+        return futures;
+    }
+
+    // Поведінка addTask/submit при заповненій черзі. Задається до подання
+    // задач. Із робочих потоків пулу задачі не чекають (інакше всі потоки
+    // могли б заблокуватися на власній черзі) і відкидаються, як у reject.
+    void set_overflow(overflow_policy policy, Clock::duration timeout = Clock::duration::zero()) {
+        overflow = policy;
+        overflow_timeout = timeout;
+    }
+
+    void shutdown() {
+        {
+            // Після stop адаптивний пул уже не запускає нових потоків.
+            std::lock_guard<std::mutex> lk(scale_mtx);
+            stop = true;
+        }
+        idle.notify_all();
+        space.notify_all();
+        for(auto &t : workers_vec) {
+            if (t.joinable()) t.join();
+        }
+    }
+
+    void show_metrics() const {
+        double avgWait = waitCycles ? (totalWaitNs / static_cast<double>(waitCycles) / 1e9) : 0;
+
+        latency_histogram::snapshot full = full_hist.read();
+        double minFull = full.min_ns() / 1e9, maxFull = full.max_ns() / 1e9;
+
+        std::cout << "Кількість робочих потоків: " << created << "\n";
+        if (elastic()) {
+            std::cout << "Межі адаптивного пулу: " << MIN_WORKERS << ".." << MAX_WORKERS
+                      << ", зараз працює: " << size() << "\n";
+            std::lock_guard<std::mutex> lk(scale_mtx);
+            for (const auto& e : scale_log) {
+                std::cout << "  " << e.at << " с: " << (e.grow ? "+1 потік (черга заповнена " : "-1 потік (простій ")
+                          << e.reason << " с) -> " << e.workers << "\n";
+            }
+        }
+        std::cout << "Спроб додати задач: " << attempted << "\n";
+        std::cout << "Завершено задач: " << completed << "\n";
+        std::cout << "Відкинуто задач: " << rejected << "\n";
+        std::cout << "Відкинуто прострочених задач: " << expired << "\n";
+        std::cout << "Середній час простою потоків (с): " << avgWait << "\n";
+        std::cout << "Найкоротший час, коли черга була повністю заповнена (с): " << minFull << "\n";
+        std::cout << "Найдовший час, коли черга була повністю заповнена (с): "   << maxFull << "\n";
+        latency_snapshots h = latencies();
+        print_percentiles("Очікування в черзі", h.queue_wait);
+        print_percentiles("Виконання", h.exec);
+        print_percentiles("Від подання до завершення", h.end_to_end);
+        for (size_t i = 0; i < states.size(); ++i) {
+            if (!states[i]->running && states[i]->executed == 0) continue;
+            std::cout << "  Потік " << i << ": виконано " << states[i]->executed
+                      << ", вкрадено " << states[i]->stolen << "\n";
+        }
+    }
+
+    // Знімок лічильників і гістограм у файл: текстовий формат Prometheus
+    // (для node_exporter textfile collector) або JSON.
+    void write_metrics(const std::string& path, metrics_format format) const {
+        std::ofstream out(path);
+        if (!out) throw std::runtime_error("Не вдалося відкрити " + path);
+        latency_snapshots h = latencies();
+        latency_histogram::snapshot full = full_hist.read();
+        const std::pair<const char*, const latency_histogram::snapshot*> hists[] = {
+            {"queue_wait", &h.queue_wait}, {"exec", &h.exec},
+            {"end_to_end", &h.end_to_end}, {"queue_full", &full},
+        };
+        const std::pair<const char*, size_t> counters[] = {
+            {"attempted", attempted}, {"accepted", accepted},
+            {"completed", completed}, {"rejected", rejected}, {"expired", expired},
+        };
+
+        if (format == metrics_format::prometheus) {
+            for (const auto& [name, value] : counters) {
+                out << "# TYPE thread_pool_tasks_" << name << "_total counter\n";
+                out << "thread_pool_tasks_" << name << "_total " << value << "\n";
+            }
+            out << "# TYPE thread_pool_workers gauge\nthread_pool_workers " << size() << "\n";
+            for (const auto& [name, snap] : hists) {
+                out << "# TYPE thread_pool_" << name << "_seconds summary\n";
+                for (double q : QUANTILES)
+                    out << "thread_pool_" << name << "_seconds{quantile=\"" << q << "\"} "
+                        << snap->percentile_ns(q) / 1e9 << "\n";
+                out << "thread_pool_" << name << "_seconds_sum " << snap->sum_ns / 1e9 << "\n";
+                out << "thread_pool_" << name << "_seconds_count " << snap->count << "\n";
+            }
+            out << "# TYPE thread_pool_worker_executed_total counter\n";
+            for (size_t i = 0; i < states.size(); ++i)
+                out << "thread_pool_worker_executed_total{worker=\"" << i << "\"} " << states[i]->executed << "\n";
+            out << "# TYPE thread_pool_worker_stolen_total counter\n";
+            for (size_t i = 0; i < states.size(); ++i)
+                out << "thread_pool_worker_stolen_total{worker=\"" << i << "\"} " << states[i]->stolen << "\n";
+        } else {
+            out << "{\n";
+            for (const auto& [name, value] : counters)
+                out << "  \"" << name << "\": " << value << ",\n";
+            out << "  \"workers\": " << size() << ",\n";
+            for (const auto& [name, snap] : hists) {
+                out << "  \"" << name << "_ns\": {\"count\": " << snap->count << ", \"mean\": " << snap->mean_ns();
+                for (double q : QUANTILES)
+                    out << ", \"p" << q * 100 << "\": " << snap->percentile_ns(q);
+                out << ", \"max\": " << snap->max_ns() << "},\n";
+            }
+            out << "  \"per_worker\": [";
+            for (size_t i = 0; i < states.size(); ++i) {
+                out << (i ? ", " : "") << "{\"executed\": " << states[i]->executed
+                    << ", \"stolen\": " << states[i]->stolen << "}";
+            }
+            out << "]\n}\n";
+        }
+        if (!out) throw std::runtime_error("Не вдалося записати " + path);
+    }
+
+private:
+    static constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+    struct latency_snapshots {
+        latency_histogram::snapshot queue_wait, exec, end_to_end;
+    };
+
+    latency_snapshots latencies() const {
+        latency_snapshots h;
+        for (const auto& st : states) {
+            h.queue_wait.merge(st->queue_wait.read());
+            h.exec.merge(st->exec.read());
+            h.end_to_end.merge(st->end_to_end.read());
+        }
+        return h;
+    }
+
+    static void print_percentiles(const char* title, const latency_histogram::snapshot& s) {
+        std::cout << title << " (мкс): p50 " << s.percentile_ns(0.5) / 1e3
+                  << ", p90 " << s.percentile_ns(0.9) / 1e3
+                  << ", p99 " << s.percentile_ns(0.99) / 1e3
+                  << ", p99.9 " << s.percentile_ns(0.999) / 1e3
+                  << ", макс. " << s.max_ns() / 1e3 << "\n";
+    }
+
+    static constexpr size_t LANES = 3;
+    // Задача з терміном, до якого лишилося менше URGENT_SLACK, іде в смугу
+    // critical, менше SOON_SLACK — не нижче normal. Так смуги наближають
+    // EDF без спільної купи під замком.
+    static constexpr std::chrono::milliseconds URGENT_SLACK{10}, SOON_SLACK{1000};
+
+    static int64_t deadline_of(const task_options& opts) {
+        if (opts.deadline == Clock::time_point::max()) return INT64_MAX;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(opts.deadline.time_since_epoch()).count();
+    }
+
+    static size_t lane_of(const task_options& opts, int64_t now) {
+        size_t lane = static_cast<size_t>(opts.priority);
+        int64_t deadline = deadline_of(opts);
+        if (deadline != INT64_MAX) {
+            int64_t slack = deadline - now;
+            if (slack < std::chrono::nanoseconds(URGENT_SLACK).count()) lane = 0;
+            else if (slack < std::chrono::nanoseconds(SOON_SLACK).count()) lane = std::min<size_t>(lane, 1);
+        }
+        return std::min(lane, LANES - 1);
+    }
+
+    size_t queued() const {
+        size_t n = 0;
+        for (const auto& lane : lanes) n += lane->size();
+        return n;
+    }
+
+    bool lanes_empty() const {
+        for (const auto& lane : lanes)
+            if (!lane->empty()) return false;
+        return true;
+    }
+
+    // node — вузол деку, з якого переносять задачу; звільняється тут.
+    bool enqueue(queued_task&& f, queued_task* node, size_t lane) {
+        attempted++;
+        bool pushed = push_tasks(&f, 1, lane) == 1;
+        if (node) slab.destroy(node);
+        if (!pushed) {
+            rejected++;
+            return false;
+        }
+        accepted++;
+        return true;
+    }
+
+    // Кладе задачі в спільну чергу з урахуванням overflow і повертає,
+    // скільки з початку масиву прийнято.
+    // CAP обмежує сумарний розмір усіх смуг (наближено: сусідні смуги
+    // можуть змінитися між підрахунком і вставкою). Смуга batch не
+    // займає останню 1/4 черги, тож навіть при перевантаженні пакетною
+    // роботою звичайні й термінові задачі мають місце; їм доступна вся CAP.
+    size_t push_tasks(queued_task* tasks, size_t n, size_t lane) {
+        size_t limit = lane_limit(lane);
+        size_t done = 0;
+        Clock::time_point deadline = Clock::time_point::max();
+        if (overflow == overflow_policy::block_for) deadline = Clock::now() + overflow_timeout;
+        while (done < n) {
+            size_t others = queued() - std::min(queued(), lanes[lane]->size());
+            size_t k = others < limit ? lanes[lane]->push_bulk(tasks + done, n - done, limit - others) : 0;
+            if (k) {
+                done += k;
+                if (queued() >= CAP) mark_full();
+                // Одна задача потребує одного потоку, тож будимо лише одного.
+                if (k == 1) idle.notify_one();
+                else idle.notify_all();
+                continue;
+            }
+            // Лише своя смуга без місця — ще не переповнення черги.
+            if (queued() >= CAP) {
+                mark_full();
+                if (elastic()) maybe_grow();
+            }
+            if (!wait_for_space(deadline, limit)) break;
+        }
+        return done;
+    }
+
+    size_t lane_limit(size_t lane) const {
+        if (lane < static_cast<size_t>(task_priority::batch)) return CAP;
+        return std::max<size_t>(1, CAP - CAP / 4);
+    }
+
+    // Запускає потік у вільному слоті; викликається під scale_mtx.
+    void spawn_locked() {
+        for (size_t i = 0; i < MAX_WORKERS; ++i) {
+            if (states[i]->running) continue;
+            // Потік, що раніше займав слот, уже вийшов або виходить.
+            if (workers_vec[i].joinable()) workers_vec[i].join();
+            states[i]->running = true;
+            active.fetch_add(1, std::memory_order_release);
+            created++;
+            workers_vec[i] = std::thread(&thread_pool::worker, this, i);
+            return;
+        }
+    }
+
+    // Додає потік, якщо черга переповнюється довше за GROW_AFTER, тобто
+    // відтоді жоден потік не залишався без роботи.
+    void maybe_grow() {
+        if (active.load(std::memory_order_acquire) >= MAX_WORKERS) return;
+        int64_t now = Clock::now().time_since_epoch().count();
+        int64_t since = saturated_since.load(std::memory_order_relaxed);
+        if (since == 0) {
+            saturated_since.compare_exchange_strong(since, now, std::memory_order_relaxed);
+            return;
+        }
+        if (now - since < GROW_AFTER.count()) return;
+        std::unique_lock<std::mutex> lk(scale_mtx, std::try_to_lock);
+        if (!lk.owns_lock() || stop || active.load() >= MAX_WORKERS) return;
+        // Наступний потік — лише після ще одного періоду GROW_AFTER.
+        if (!saturated_since.compare_exchange_strong(since, now, std::memory_order_relaxed)) return;
+        spawn_locked();
+        log_scale(true, Clock::duration(now - since) / std::chrono::duration<double>(1));
+        idle.notify_one();
+    }
+
+    // Завершує потік index, якщо пул може обійтися без нього.
+    bool try_retire(size_t index, double idleFor) {
+        std::lock_guard<std::mutex> lk(scale_mtx);
+        if (stop || active.load() <= MIN_WORKERS) return false;
+        active.fetch_sub(1, std::memory_order_release);
+        states[index]->running = false;
+        log_scale(false, idleFor);
+        return true;
+    }
+
+    // Викликається під scale_mtx.
+    void log_scale(bool grow, double reason) {
+        double at = std::chrono::duration<double>(Clock::now() - started_at).count();
+        scale_log.push_back({at, active.load(), grow, reason});
+    }
+
+    // Чекає, доки в черзі стане менше limit задач (межа смуги, а не CAP:
+    // інакше смуга batch без місця крутилася б у push_tasks).
+    bool wait_for_space(Clock::time_point deadline, size_t limit) {
+        if (overflow == overflow_policy::reject || current_pool == this) return false;
+        if (Clock::now() >= deadline) return false;
+        uint32_t key = space.prepare_wait();
+        if (queued() < limit || stop) {
+            space.cancel_wait();
+            return !stop;
+        }
+        // Адаптивний пул прокидається раз на GROW_AFTER, щоб вирішити,
+        // чи додати потік; до дедлайну продовжуємо чекати.
+        if (elastic() && deadline - Clock::now() > GROW_AFTER) {
+            space.wait_until(key, Clock::now() + GROW_AFTER);
+            return !stop;
+        }
+        return space.wait_until(key, deadline) && !stop;
+    }
+
+    void mark_full() {
+        if (is_full) return;
+        auto now = Clock::now();
+        write_lock lg(metrics_mtx);
+        if (!is_full) {
+            full_start = now;
+            is_full = true;
+        }
+    }
+
+    struct worker_state {
+        ws_deque<queued_task> deque;
+        std::atomic<bool> running{false};
+        alignas(64) std::atomic<size_t> executed{0};
+        std::atomic<size_t> stolen{0};
+        // Пише лише власний потік; show_metrics об'єднує гістограми всіх потоків.
+        latency_histogram queue_wait, exec, end_to_end;
+    };
+
+    bool has_local_work() const {
+        for (const auto& st : states)
+            if (!st->deque.empty()) return true;
+        return false;
+    }
+
+    // Власний дек, потім спільна черга, потім крадіжка з випадкового потоку.
+    bool next_task(size_t index, std::minstd_rand& rng, queued_task& task) {
+        if (MODE == pool_mode::work_stealing) {
+            if (auto* local = states[index]->deque.pop()) {
+                task = std::move(*local);
+                slab.destroy(local);
+                return true;
+            }
+        }
+        for (auto& lane : lanes) {
+            if (lane->pop(task)) {
+                space.notify_one();
+                return true;
+            }
+        }
+        if (MODE == pool_mode::work_stealing && MAX_WORKERS > 1) {
+            size_t start = rng() % MAX_WORKERS;
+            for (size_t k = 0; k < MAX_WORKERS; ++k) {
+                size_t victim = (start + k) % MAX_WORKERS;
+                if (victim == index) continue;
+                if (auto* stolen = states[victim]->deque.steal()) {
+                    task = std::move(*stolen);
+                    slab.destroy(stolen);
+                    states[index]->stolen++;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void worker(size_t index) {
+        current_worker = index;
+        current_pool = this;
+        if (on_start) on_start(index);
+        std::minstd_rand rng(static_cast<unsigned>(index + 1));
+        // Мітка завершення попередньої задачі — водночас початок очікування.
+        auto start_wait = Clock::now();
+        while (true) {
+            queued_task task;
+            bool idle_expired = false;
+            while (!next_task(index, rng, task)) {
+                if (stop && !has_local_work()) return;
+                saturated_since.store(0, std::memory_order_relaxed);
+                // Черга ще раз перевірена після тайм-ауту, тож задача, додана
+                // під час очікування, не залишиться без виконавця.
+                if (idle_expired && try_retire(index, std::chrono::duration<double>(Clock::now() - start_wait).count()))
+                    return;
+                uint32_t key = idle.prepare_wait();
+                if (!lanes_empty() || has_local_work() || stop) {
+                    idle.cancel_wait();
+                    continue;
+                }
+                if (elastic()) idle_expired = !idle.wait_until(key, Clock::now() + RETIRE_AFTER);
+                else idle.wait(key);
+            }
+            auto end_wait = Clock::now();
+            totalWaitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end_wait - start_wait).count();
+            waitCycles++;
+
+            // Прапорець читається без блокування; замок потрібен лише
+            // тому, хто першим побачив заповнену чергу після звільнення.
+            if (is_full) {
+                bool record = false;
+                Clock::time_point start_tp;
+                {
+                    write_lock lg(metrics_mtx);
+                    if (is_full) {
+                        is_full = false;
+                        start_tp = full_start;
+                        record = true;
+                    }
+                }
+                if (record)
+                    full_hist.record_concurrent(std::chrono::duration_cast<std::chrono::nanoseconds>(end_wait - start_tp).count());
+            }
+
+            worker_state& st = *states[index];
+            int64_t started = std::chrono::duration_cast<std::chrono::nanoseconds>(end_wait.time_since_epoch()).count();
+            if (started > task.deadline_ns) {
+                // Деструктор задачі завершить її future винятком.
+                expired++;
+                start_wait = end_wait;
+                continue;
+            }
+            completed++;
+            st.executed++;
+            task.fn();
+            start_wait = Clock::now();
+            int64_t finished = std::chrono::duration_cast<std::chrono::nanoseconds>(start_wait.time_since_epoch()).count();
+            st.queue_wait.record(static_cast<uint64_t>(std::max<int64_t>(0, started - task.enqueued_ns)));
+            st.exec.record(static_cast<uint64_t>(finished - started));
+            st.end_to_end.record(static_cast<uint64_t>(std::max<int64_t>(0, finished - task.enqueued_ns)));
+        }
+    }
+
+    const size_t MIN_WORKERS;
+    const size_t MAX_WORKERS;
+    const size_t CAP;
+    const pool_mode MODE;
+    const Clock::duration GROW_AFTER;
+    const Clock::duration RETIRE_AFTER;
+    std::function<void(size_t)> on_start;
+    static inline thread_local size_t current_worker = SIZE_MAX;
+    static inline thread_local thread_pool* current_pool = nullptr;
+    task_slab slab;
+    std::unique_ptr<mpmc_queue<queued_task>> lanes[LANES];
+    std::vector<std::unique_ptr<worker_state>> states;
+    std::vector<std::thread> workers_vec;
+
+    event_count idle;
+    event_count space;
+    overflow_policy overflow = overflow_policy::reject;
+    Clock::duration overflow_timeout{};
+    std::atomic<bool> stop{false};
+
+    std::atomic<size_t> active{0};
+    std::atomic<int64_t> saturated_since{0};
+    // Збільшується під scale_mtx, а show_metrics читає без нього.
+    std::atomic<size_t> created{0};
+
+    struct scale_event {
+        double at;
+        size_t workers;
+        bool grow;
+        double reason;
+    };
+    mutable std::mutex scale_mtx;
+    Clock::time_point started_at;
+    std::vector<scale_event> scale_log;
+    std::atomic<size_t> attempted{0}, accepted{0}, completed{0}, rejected{0}, expired{0};
+
+    mutable read_write_lock metrics_mtx;
+    std::atomic<bool> is_full{false};
+    Clock::time_point full_start;
+    latency_histogram full_hist;
+
+    std::atomic<uint64_t> totalWaitNs{0}, waitCycles{0};
+};
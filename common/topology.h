@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <set>
+#include <utility>
+#include <thread>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#endif
+
+// Відомості про процесор, потрібні для розбиття роботи між потоками.
+struct CpuTopology {
+    size_t logicalCpus = 1;
+    size_t physicalCores = 1;
+    size_t l2CacheBytes = 1 << 20;
+    // Логічні процесори у порядку закріплення: спершу по одному на
+    // кожне фізичне ядро, потім їхні гіперпотоки.
+    std::vector<size_t> cpuOrder;
+};
+
+#ifdef _WIN32
+
+inline CpuTopology readTopology() {
+    CpuTopology topo;
+    DWORD len = 0;
+    GetLogicalProcessorInformation(nullptr, &len);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (info.empty() || !GetLogicalProcessorInformation(info.data(), &len)) {
+        topo.logicalCpus = topo.physicalCores = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < topo.logicalCpus; ++i) topo.cpuOrder.push_back(i);
+        return topo;
+    }
+
+    std::vector<size_t> siblings;
+    size_t cores = 0;
+    for (const auto& item : info) {
+        if (item.Relationship == RelationProcessorCore) {
+            ++cores;
+            bool first = true;
+            for (size_t bit = 0; bit < sizeof(ULONG_PTR) * 8; ++bit) {
+                if (!(item.ProcessorMask & (ULONG_PTR(1) << bit))) continue;
+                if (first) topo.cpuOrder.push_back(bit);
+                else siblings.push_back(bit);
+                first = false;
+            }
+        } else if (item.Relationship == RelationCache && item.Cache.Level == 2) {
+            topo.l2CacheBytes = item.Cache.Size;
+        }
+    }
+    topo.cpuOrder.insert(topo.cpuOrder.end(), siblings.begin(), siblings.end());
+    topo.physicalCores = std::max<size_t>(cores, 1);
+    topo.logicalCpus = std::max<size_t>(topo.cpuOrder.size(), 1);
+    return topo;
+}
+
+inline bool pinCurrentThread(size_t cpu) {
+    if (cpu >= sizeof(DWORD_PTR) * 8) return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+}
+
+#else
+
+inline bool readSysValue(const std::string& path, std::string& value) {
+    std::ifstream in(path);
+    return static_cast<bool>(in >> value);
+}
+
+// Розмір на кшталт "2048K" або "32M" з /sys/devices/system/cpu/.../cache.
+inline size_t parseCacheSize(const std::string& s) {
+    size_t value = 0, i = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') value = value * 10 + (s[i++] - '0');
+    if (i < s.size() && (s[i] == 'K' || s[i] == 'k')) value <<= 10;
+    else if (i < s.size() && (s[i] == 'M' || s[i] == 'm')) value <<= 20;
+    return value;
+}
+
+inline CpuTopology readTopology() {
+    CpuTopology topo;
+    const std::string base = "/sys/devices/system/cpu/";
+    std::set<std::pair<std::string, std::string>> cores;
+    std::vector<size_t> siblings;
+
+    size_t configured = std::max(1L, sysconf(_SC_NPROCESSORS_CONF));
+    for (size_t cpu = 0; cpu < configured; ++cpu) {
+        std::string dir = base + "cpu" + std::to_string(cpu) + "/";
+        std::string online;
+        if (readSysValue(dir + "online", online) && online == "0") continue;
+
+        std::string package = "0", core = std::to_string(cpu);
+        readSysValue(dir + "topology/physical_package_id", package);
+        readSysValue(dir + "topology/core_id", core);
+        if (cores.insert({package, core}).second) topo.cpuOrder.push_back(cpu);
+        else siblings.push_back(cpu);
+    }
+    topo.cpuOrder.insert(topo.cpuOrder.end(), siblings.begin(), siblings.end());
+    topo.physicalCores = std::max<size_t>(cores.size(), 1);
+    topo.logicalCpus = std::max<size_t>(topo.cpuOrder.size(), 1);
+
+    for (int index = 0; index < 8; ++index) {
+        std::string dir = base + "cpu0/cache/index" + std::to_string(index) + "/";
+        std::string level, size;
+        if (!readSysValue(dir + "level", level)) break;
+        if (level == "2" && readSysValue(dir + "size", size)) {
+            if (size_t bytes = parseCacheSize(size)) topo.l2CacheBytes = bytes;
+            break;
+        }
+    }
+    return topo;
+}
+
+inline bool pinCurrentThread(size_t cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
+
+// Топологія читається один раз за процес.
+inline const CpuTopology& cpuTopology() {
+    static const CpuTopology topo = readTopology();
+    return topo;
+}
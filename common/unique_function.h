@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Пул блоків фіксованого розміру для замикань, що не вміщуються в
+// unique_function. Вільні блоки утворюють стек Трайбера з індексами;
+// лічильник у старших 32 бітах голови захищає від ABA. Коли блоки
+// закінчуються, пам'ять береться зі звичайного operator new.
+class task_slab {
+public:
+    static constexpr size_t BLOCK = 256;
+    static constexpr size_t ALIGN = 64;
+
+    explicit task_slab(size_t blocks)
+        : count(static_cast<uint32_t>(blocks)),
+          storage(static_cast<char*>(::operator new(blocks * BLOCK, std::align_val_t(ALIGN)))),
+          next(new std::atomic<uint32_t>[blocks]) {
+        for (uint32_t i = 0; i < count; ++i)
+            next[i].store(i + 1, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+    }
+
+    task_slab(const task_slab&) = delete;
+    task_slab& operator=(const task_slab&) = delete;
+
+    ~task_slab() { ::operator delete(storage, std::align_val_t(ALIGN)); }
+
+    void* allocate(size_t bytes) {
+        if (bytes <= BLOCK) {
+            uint64_t h = head.load(std::memory_order_acquire);
+            while (index(h) != count) {
+                uint32_t idx = index(h);
+                uint64_t nh = pack(next[idx].load(std::memory_order_relaxed), tag(h) + 1);
+                if (head.compare_exchange_weak(h, nh, std::memory_order_acquire, std::memory_order_acquire))
+                    return storage + size_t(idx) * BLOCK;
+            }
+        }
+        return ::operator new(bytes, std::align_val_t(ALIGN));
+    }
+
+    void deallocate(void* p) {
+        char* c = static_cast<char*>(p);
+        if (c < storage || c >= storage + size_t(count) * BLOCK) {
+            ::operator delete(p, std::align_val_t(ALIGN));
+            return;
+        }
+        uint32_t idx = static_cast<uint32_t>((c - storage) / BLOCK);
+        uint64_t h = head.load(std::memory_order_relaxed);
+        do {
+            next[idx].store(index(h), std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(h, pack(idx, tag(h) + 1),
+                                             std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(alignof(T) <= ALIGN, "Завелике вирівнювання для task_slab");
+        return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    void destroy(T* p) {
+        p->~T();
+        deallocate(p);
+    }
+
+private:
+    static uint32_t index(uint64_t h) { return static_cast<uint32_t>(h); }
+    static uint32_t tag(uint64_t h) { return static_cast<uint32_t>(h >> 32); }
+    static uint64_t pack(uint32_t idx, uint32_t t) { return (uint64_t(t) << 32) | idx; }
+
+    const uint32_t count;
+    char* storage;
+    std::unique_ptr<std::atomic<uint32_t>[]> next;
+    alignas(64) std::atomic<uint64_t> head;
+};
+
+template<typename Sig>
+class unique_function;
+
+// Лише переміщувана заміна std::function. Замикання до INLINE байтів
+// зберігаються всередині об'єкта (разом із таблицею операцій — 64 байти),
+// більші — у блоці task_slab, якщо його передано, інакше в купі.
+template<typename R, typename... Args>
+class unique_function<R(Args...)> {
+public:
+    static constexpr size_t INLINE = 48;
+
+    unique_function() noexcept = default;
+    unique_function(std::nullptr_t) noexcept {}
+
+    template<typename F, typename D = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same_v<D, unique_function>>>
+    unique_function(F&& f, task_slab* slab = nullptr) {
+        if constexpr (fits_inline<D>()) {
+            new (buf) D(std::forward<F>(f));
+            vt = &inline_ops<D>;
+        } else {
+            static_assert(alignof(D) <= task_slab::ALIGN, "Завелике вирівнювання замикання");
+            void* mem = slab ? slab->allocate(sizeof(D)) : ::operator new(sizeof(D), std::align_val_t(task_slab::ALIGN));
+            new (buf) heap_box{new (mem) D(std::forward<F>(f)), slab};
+            vt = &heap_ops<D>;
+        }
+    }
+
+    unique_function(unique_function&& o) noexcept : vt(o.vt) {
+        if (vt) {
+            vt->move(buf, o.buf);
+            o.vt = nullptr;
+        }
+    }
+
+    unique_function& operator=(unique_function&& o) noexcept {
+        if (this != &o) {
+            reset();
+            vt = o.vt;
+            if (vt) {
+                vt->move(buf, o.buf);
+                o.vt = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    unique_function& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    unique_function(const unique_function&) = delete;
+    unique_function& operator=(const unique_function&) = delete;
+
+    ~unique_function() { reset(); }
+
+    explicit operator bool() const noexcept { return vt != nullptr; }
+
+    R operator()(Args... args) {
+        return vt->invoke(buf, std::forward<Args>(args)...);
+    }
+
+private:
+    struct ops {
+        R (*invoke)(void*, Args&&...);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    struct heap_box {
+        void* fn;
+        task_slab* slab;
+    };
+
+    template<typename D>
+    static constexpr bool fits_inline() {
+        return sizeof(D) <= INLINE && alignof(D) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible_v<D>;
+    }
+
+    template<typename D>
+    static constexpr ops inline_ops = {
+        [](void* p, Args&&... args) -> R { return (*static_cast<D*>(p))(std::forward<Args>(args)...); },
+        [](void* dst, void* src) noexcept {
+            new (dst) D(std::move(*static_cast<D*>(src)));
+            static_cast<D*>(src)->~D();
+        },
+        [](void* p) noexcept { static_cast<D*>(p)->~D(); },
+    };
+
+    template<typename D>
+    static constexpr ops heap_ops = {
+        [](void* p, Args&&... args) -> R {
+            return (*static_cast<D*>(static_cast<heap_box*>(p)->fn))(std::forward<Args>(args)...);
+        },
+        [](void* dst, void* src) noexcept { std::memcpy(dst, src, sizeof(heap_box)); },
+        [](void* p) noexcept {
+            heap_box* box = static_cast<heap_box*>(p);
+            D* fn = static_cast<D*>(box->fn);
+            fn->~D();
+            if (box->slab) box->slab->deallocate(fn);
+            else ::operator delete(fn, std::align_val_t(task_slab::ALIGN));
+        },
+    };
+
+    void reset() noexcept {
+        if (vt) {
+            vt->destroy(buf);
+            vt = nullptr;
+        }
+    }
+
+    const ops* vt = nullptr;
+    alignas(std::max_align_t) unsigned char buf[INLINE];
+};
@@ -1,12 +1,28 @@
+#ifdef _WIN32
+#define NOMINMAX
 #include <windows.h>
+#else
+#include <sys/sysinfo.h>
+#include <unistd.h>
+#endif
 #include <iostream>
 #include <chrono>
 #include <thread>
 #include <vector>
+#include <memory>
 #include <iomanip>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include "../common/column_max.h"
+#include "../common/parallel_for.h"
+#include "../common/random_matrix.h"
 
 using namespace std;
 
+#ifdef _WIN32
 void printCPUInfo() {
     SYSTEM_INFO sysInfo;
     GetSystemInfo(&sysInfo);
@@ -56,90 +72,283 @@ void printMemoryInfo() {
     }
     cout << "\n";
 }
+#else
+void printCPUInfo() {
+    cout << "=== Інформація про процесор ===\n";
 
-vector<vector<int>> createRandomMatrix(int n) {
-    vector<vector<int>> mat(n, vector<int>(n));
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            mat[i][j] = rand() % 1001;
-        }
+    cout << "Архітектура процесора: ";
+#if defined(__x86_64__)
+    cout << "x64 (AMD або Intel)\n";
+#elif defined(__i386__)
+    cout << "x86\n";
+#elif defined(__aarch64__)
+    cout << "ARM64\n";
+#elif defined(__arm__)
+    cout << "ARM\n";
+#else
+    cout << "Невідома архітектура\n";
+#endif
+
+    cout << "Логічних процесорів: " << sysconf(_SC_NPROCESSORS_ONLN) << "\n";
+    cout << "Розмір сторінки пам'яті: " << sysconf(_SC_PAGESIZE) << " байт\n";
+    cout << "\n";
+}
+
+void printMemoryInfo() {
+    struct sysinfo info;
+
+    cout << "=== Інформація про пам'ять ===\n";
+    if (sysinfo(&info) == 0) {
+        double totalGB = static_cast<double>(info.totalram) * info.mem_unit / (1024.0 * 1024 * 1024);
+        double availGB = static_cast<double>(info.freeram) * info.mem_unit / (1024.0 * 1024 * 1024);
+        cout << "Загальна фізична пам'ять (RAM): " << fixed << setprecision(2)
+                  << totalGB << " GB\n";
+        cout << "Доступна фізична пам'ять (RAM): " << fixed << setprecision(2)
+                  << availGB << " GB\n";
+    } else {
+        cerr << "Помилка отримання інформації про пам'ять.\n";
     }
+    cout << "\n";
+}
+#endif
+
+Matrix<int> createRandomMatrix(int n, uint64_t seed, fork_join_executor& pool) {
+    Matrix<int> mat(n, n);
+    fillRandomMatrix(mat, seed, 1001, pool);
     return mat;
 }
 
-void nonParallelSolution(vector<vector<int>>& mat) {
-    int n = static_cast<int>(mat.size());
+void nonParallelSolution(Matrix<int>& mat) {
+    int n = static_cast<int>(mat.rows());
+    vector<int> maxVals(n);
+    columnMaxStrip(mat, 0, n, maxVals.data());
     for (int j = 0; j < n; j++) {
-        int maxVal = mat[0][j];
-        for (int i = 1; i < n; i++) {
-            if (mat[i][j] > maxVal)
-                maxVal = mat[i][j];
-        }
-        mat[j][j] = maxVal;
+        mat(j, j) = maxVals[j];
     }
 }
 
-void parallelColumnMax(vector<vector<int>>& mat, int start, int end) {
-    int n = static_cast<int>(mat.size());
+void parallelColumnMax(Matrix<int>& mat, int start, int end) {
+    vector<int> maxVals(end - start);
+    columnMaxStrip(mat, start, end, maxVals.data());
     for (int j = start; j < end; j++) {
-        int maxVal = mat[0][j];
-        for (int i = 1; i < n; i++) {
-            if (mat[i][j] > maxVal)
-                maxVal = mat[i][j];
+        mat(j, j) = maxVals[j - start];
+    }
+}
+
+// Як розбивати роботу між потоками пулу.
+enum class Partition {
+    Columns,  // смуги по n / threads стовпців
+    Tiled,    // тайли з цілих кеш-ліній розміром під L2
+    NumaRows  // кожен потік володіє смугою рядків (first-touch) і тайлами стовпців
+};
+
+struct Options {
+    Partition partition = Partition::Columns;
+    bool pin = false;
+    bool topology = false;
+    uint64_t seed = static_cast<uint64_t>(time(nullptr));
+};
+
+Options parseOptions(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--tiled") opt.partition = Partition::Tiled;
+        else if (arg == "--numa") opt.partition = Partition::NumaRows;
+        else if (arg == "--pin") opt.pin = true;
+        else if (arg == "--topology") opt.topology = true;
+        else if (arg == "--seed" && i + 1 < argc) opt.seed = stoull(argv[++i]);
+        else cerr << "Невідомий параметр: " << arg << "\n";
+    }
+    return opt;
+}
+
+const char* partitionName(Partition partition) {
+    switch (partition) {
+        case Partition::Tiled:    return "тайли під L2";
+        case Partition::NumaRows: return "смуги рядків (NUMA)";
+        default:                  return "смуги стовпців";
+    }
+}
+
+void parallelSolution(Matrix<int>& mat, fork_join_executor& pool, int numThreads) {
+    int n = static_cast<int>(mat.rows());
+    int columnsPerThread = (n + numThreads - 1) / numThreads;
+    pool.parallel_for(0, n, columnsPerThread, [&](size_t start, size_t end) {
+        parallelColumnMax(mat, static_cast<int>(start), static_cast<int>(end));
+    });
+}
+
+void tiledSolution(Matrix<int>& mat, fork_join_executor& pool) {
+    size_t tile = columnTileWidth<int>(cpuTopology().l2CacheBytes);
+    pool.parallel_for(0, mat.cols(), tile, [&](size_t start, size_t end) {
+        parallelColumnMax(mat, static_cast<int>(start), static_cast<int>(end));
+    });
+}
+
+void numaRowsSolution(Matrix<int>& mat, fork_join_executor& pool) {
+    size_t n = mat.rows();
+    size_t tile = columnTileWidth<int>(cpuTopology().l2CacheBytes);
+    // Рядок w — частковий максимум потоку w; рядки вирівняні на кеш-лінію.
+    Matrix<int> partial(pool.workers(), n);
+
+    pool.for_each_worker([&](size_t w, size_t workers) {
+        auto [r0, r1] = split_range(n, workers, w);
+        int* acc = partial.row(w);
+        fill(acc, acc + n, INT_MIN);
+        for (size_t c0 = 0; c0 < n; c0 += tile) {
+            size_t c1 = min(n, c0 + tile);
+            columnMaxRows(mat, r0, r1, c0, c1, acc + c0);
+        }
+    });
+
+    pool.parallel_for(0, n, tile, [&](size_t c0, size_t c1) {
+        vector<int> maxVals(c1 - c0);
+        columnMaxStrip(partial, c0, c1, maxVals.data());
+        for (size_t j = c0; j < c1; j++) {
+            mat(j, j) = maxVals[j - c0];
         }
-        mat[j][j] = maxVal;
+    });
+}
+
+// Копія, сторінки кожної смуги рядків якої першим торкається потік-власник.
+Matrix<int> copyFirstTouch(const Matrix<int>& src, fork_join_executor& pool) {
+    Matrix<int> dst(src.rows(), src.cols());
+    pool.for_each_worker([&](size_t w, size_t workers) {
+        auto [r0, r1] = split_range(src.rows(), workers, w);
+        if (r0 < r1)
+            memcpy(dst.row(r0), src.row(r0), (r1 - r0) * src.stride() * sizeof(int));
+    });
+    return dst;
+}
+
+void runPartition(Matrix<int>& mat, fork_join_executor& pool, int numThreads, Partition partition) {
+    switch (partition) {
+        case Partition::Tiled:    tiledSolution(mat, pool); break;
+        case Partition::NumaRows: numaRowsSolution(mat, pool); break;
+        default:                  parallelSolution(mat, pool, numThreads); break;
     }
 }
 
-void parallelSolution(vector<vector<int>>& mat, int numThreads) {
-    int n = static_cast<int>(mat.size());
-    vector<thread> threads;
-    int columnsPerThread = n / numThreads;
-    int remainder = n % numThreads;
-    int start = 0;
-    for (int t = 0; t < numThreads; t++) {
-        int extra = (t < remainder) ? 1 : 0;
-        int end = start + columnsPerThread + extra;
-        threads.push_back(thread(parallelColumnMax, ref(mat), start, end));
-        start = end;
+// Кожне ядро порівнюється зі скалярним на матриці rows x cols.
+template<typename T>
+bool checkKernelsOn(const Matrix<T>& mat, const string& label) {
+    size_t n = mat.cols();
+    vector<T> expected(mat.row(0), mat.row(0) + n);
+    columnMaxScalar(expected.data(), mat.row(1), mat.stride(), mat.rows() - 1, n);
+    bool allOk = true;
+    for (Isa isa : {Isa::SSE41, Isa::AVX2, Isa::AVX512}) {
+        if (!isaSupported(isa)) continue;
+        vector<T> actual(mat.row(0), mat.row(0) + n);
+        columnMaxKernel<T>(isa)(actual.data(), mat.row(1), mat.stride(), mat.rows() - 1, n);
+        bool ok = actual == expected;
+        allOk = allOk && ok;
+        cout << label << ", " << isaName(isa) << ": " << (ok ? "OK" : "ПОМИЛКА") << "\n";
     }
-    for (auto& th : threads) {
-        th.join();
+    return allOk;
+}
+
+// Значення на весь діапазон 32 бітів: для uint32_t половина >= 2^31, для int
+// половина від'ємна, тож плутанина знакового й беззнакового max (epi32/epu32)
+// дає іншу відповідь.
+template<typename T>
+Matrix<T> fullRangeMatrix(size_t rows, size_t cols, uint64_t seed) {
+    Matrix<T> mat(rows, cols);
+    for (size_t i = 0; i < rows; ++i)
+        for (size_t j = 0; j < cols; ++j)
+            mat(i, j) = static_cast<T>(Philox4x32::generate(static_cast<uint32_t>(i), static_cast<uint32_t>(j), 0, 0, seed).v[0]);
+    return mat;
+}
+
+bool checkColumnMaxKernels(fork_join_executor& pool, uint64_t seed) {
+    cout << "=== Перевірка SIMD-ядер (обрано: " << isaName(detectIsa()) << ") ===\n";
+    bool allOk = true;
+    for (int n : {1, 7, 1001})
+        allOk = checkKernelsOn(createRandomMatrix(n, seed, pool), "N = " + to_string(n)) && allOk;
+    for (size_t cols : {1, 7, 37, 1001}) {
+        string size = "33 x " + to_string(cols);
+        allOk = checkKernelsOn(fullRangeMatrix<uint32_t>(33, cols, seed), "uint32_t " + size) && allOk;
+        allOk = checkKernelsOn(fullRangeMatrix<int>(33, cols, seed), "int зі знаком " + size) && allOk;
     }
+    cout << "\n";
+    return allOk;
+}
+
+double throughputGBs(const Matrix<int>& mat, double seconds) {
+    return seconds > 0 ? mat.bytes() / seconds / 1e9 : 0.0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
+#endif
+    Options opt = parseOptions(argc, argv);
     printCPUInfo();
     printMemoryInfo();
 
-    srand(GetTickCount());
+    fork_join_executor genPool(cpuTopology().logicalCpus);
+
+    if (!checkColumnMaxKernels(genPool, opt.seed)) {
+        cerr << "SIMD-ядра дають інший результат, ніж скалярне.\n";
+        return 1;
+    }
 
     vector<int> matrixSizes = {100, 1000, 10000, 50000};
     vector<int> threadCounts = {4, 8, 16, 32, 64, 128, 256};
 
+    const CpuTopology& topo = cpuTopology();
+    if (opt.topology) {
+        cout << "=== Топологія ===\n";
+        cout << "Фізичних ядер: " << topo.physicalCores << ", логічних процесорів: " << topo.logicalCpus
+             << ", L2: " << topo.l2CacheBytes / 1024 << " KB\n";
+        cout << "Робочих потоків у пулі не більше, ніж фізичних ядер.\n\n";
+    }
+    cout << "Зерно генератора: " << opt.seed << "\n";
+    cout << "Розбиття: " << partitionName(opt.partition)
+         << (opt.pin ? ", потоки закріплені за ядрами" : "") << "\n\n";
+
+    cout << "=== Створення пулів потоків ===\n";
+    vector<unique_ptr<fork_join_executor>> pools;
+    for (int threads : threadCounts) {
+        size_t workers = opt.topology ? min<size_t>(threads, topo.physicalCores) : threads;
+        auto startTime = chrono::high_resolution_clock::now();
+        pools.push_back(make_unique<fork_join_executor>(workers, opt.pin));
+        auto endTime = chrono::high_resolution_clock::now();
+        chrono::duration<double> duration = endTime - startTime;
+        cout << "Потоків " << threads << " (робочих " << workers << "): "
+             << fixed << setprecision(6) << duration.count() << " секунд.\n";
+    }
+
     for (int n : matrixSizes) {
         cout << "\n=== Розмір матриці: " << n << " x " << n << " ===\n";
 
-        vector<vector<int>> mat = createRandomMatrix(n);
+        auto genStart = chrono::high_resolution_clock::now();
+        Matrix<int> mat = createRandomMatrix(n, opt.seed, genPool);
+        auto genEnd = chrono::high_resolution_clock::now();
+        cout << "Генерація матриці: " << fixed << setprecision(6)
+             << chrono::duration<double>(genEnd - genStart).count() << " секунд.\n";
 
         auto startTime = chrono::high_resolution_clock::now();
         nonParallelSolution(mat);
         auto endTime = chrono::high_resolution_clock::now();
         chrono::duration<double> duration = endTime - startTime;
-        cout << "Послідовний час виконання: " << fixed << setprecision(6) << duration.count() << " секунд.\n";
+        cout << "Послідовний час виконання: " << fixed << setprecision(6) << duration.count() << " секунд, "
+             << setprecision(2) << throughputGBs(mat, duration.count()) << " GB/s.\n";
 
-        for (int threads : threadCounts) {
-            vector<vector<int>> matParallel = mat;
+        for (size_t k = 0; k < threadCounts.size(); k++) {
+            int threads = threadCounts[k];
+            Matrix<int> matParallel = opt.partition == Partition::NumaRows
+                                          ? copyFirstTouch(mat, *pools[k]) : mat;
 
             auto startTime = chrono::high_resolution_clock::now();
-            parallelSolution(matParallel, threads);
+            runPartition(matParallel, *pools[k], threads, opt.partition);
             auto endTime = chrono::high_resolution_clock::now();
 
             chrono::duration<double> duration = endTime - startTime;
-            cout << "Паралельний час (потоків " << threads << "): " << fixed << setprecision(6) << duration.count() << " секунд.\n";
+            cout << "Паралельний час (потоків " << threads << "): " << fixed << setprecision(6) << duration.count() << " секунд, "
+                 << setprecision(2) << throughputGBs(matParallel, duration.count()) << " GB/s.\n";
         }
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,5 +1,8 @@
 #include <iostream>
+#ifdef _WIN32
+#define NOMINMAX
 #include <windows.h>
+#endif
 #include <vector>
 #include <thread>
 #include <mutex>
@@ -7,12 +10,23 @@
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
+#include <functional>
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <string>
+
+#include "../common/filter_reduce.h"
+#include "../common/mapped_file.h"
 
 using namespace std;
 using namespace chrono;
 
 vector<int> generate_data(int size) {
     vector<int> data;
+    data.reserve(size);
     for (int i = 0; i < size; ++i) {
         data.push_back(rand() % 1001);
     }
@@ -29,6 +43,22 @@ int sequential(const vector<int>& data) {
     return result;
 }
 
+// Межі t-ї з num_threads майже рівних частин [0, size).
+pair<size_t, size_t> thread_range(size_t size, int num_threads, int t) {
+    size_t base = size / num_threads, rem = size % num_threads;
+    size_t start = t * base + min<size_t>(t, rem);
+    return {start, start + base + (static_cast<size_t>(t) < rem ? 1 : 0)};
+}
+
+template<typename Body>
+void run_threads(int num_threads, Body body) {
+    vector<thread> threads;
+    threads.reserve(num_threads);
+    for (int t = 0; t < num_threads; ++t)
+        threads.emplace_back(body, t);
+    for (auto& th : threads) th.join();
+}
+
 void process_mutex(const vector<int>& data, int start, int end, int& result, mutex& mtx) {
     for (int i = start; i < end; ++i) {
         if (data[i] % 7 == 0) {
@@ -38,15 +68,13 @@ void process_mutex(const vector<int>& data, int start, int end, int& result, mut
     }
 }
 
-int parallel_mutex(const vector<int>& data) {
+int parallel_mutex(const vector<int>& data, int num_threads) {
     int result = 0;
     mutex mtx;
-    int mid = data.size() / 2;
-
-    thread t1(process_mutex, cref(data), 0, mid, ref(result), ref(mtx));
-    thread t2(process_mutex, cref(data), mid, data.size(), ref(result), ref(mtx));
-    t1.join(); t2.join();
-
+    run_threads(num_threads, [&](int t) {
+        auto [start, end] = thread_range(data.size(), num_threads, t);
+        process_mutex(data, start, end, result, mtx);
+    });
     return result;
 }
 
@@ -59,48 +87,349 @@ void process_atomic(const vector<int>& data, int start, int end, atomic<int>& re
     }
 }
 
-int parallel_atomic(const vector<int>& data) {
+int parallel_atomic(const vector<int>& data, int num_threads) {
     atomic<int> result(0);
-    int mid = data.size() / 2;
+    run_threads(num_threads, [&](int t) {
+        auto [start, end] = thread_range(data.size(), num_threads, t);
+        process_atomic(data, start, end, result);
+    });
+    return result.load();
+}
 
-    thread t1(process_atomic, cref(data), 0, mid, ref(result));
-    thread t2(process_atomic, cref(data), mid, data.size(), ref(result));
-    t1.join(); t2.join();
+void process_fetch_xor(const vector<int>& data, int start, int end, atomic<int>& result) {
+    for (int i = start; i < end; ++i) {
+        if (data[i] % 7 == 0) {
+            result.fetch_xor(data[i], memory_order_relaxed);
+        }
+    }
+}
 
+int parallel_fetch_xor(const vector<int>& data, int num_threads) {
+    atomic<int> result(0);
+    run_threads(num_threads, [&](int t) {
+        auto [start, end] = thread_range(data.size(), num_threads, t);
+        process_fetch_xor(data, start, end, result);
+    });
     return result.load();
 }
 
-void test_size(int size) {
-    cout << "\nРозмір масиву: " << size << " елементів\n";
-    vector<int> data = generate_data(size);
+// Акумулятор на всю кеш-лінію, щоб сусідні потоки не ділили одну лінію.
+template<typename T>
+struct alignas(64) padded {
+    T value;
+};
+
+// Кожен потік редукує свою частину у власний акумулятор;
+// акумулятори об'єднуються один раз після join.
+// body(start, end, identity) повертає редукцію елементів [start, end).
+template<typename T, typename Op, typename Body>
+T parallel_reduce(size_t size, int num_threads, T identity, Op op, Body body) {
+    vector<padded<T>> partial(num_threads, padded<T>{identity});
+    run_threads(num_threads, [&](int t) {
+        auto [start, end] = thread_range(size, num_threads, t);
+        partial[t].value = body(start, end, identity);
+    });
+    T result = identity;
+    for (const auto& p : partial) result = op(result, p.value);
+    return result;
+}
+
+int parallel_sharded(const vector<int>& data, int num_threads) {
+    return parallel_reduce(data.size(), num_threads, 0, bit_xor<int>(),
+        [&](size_t start, size_t end, int acc) {
+            for (size_t i = start; i < end; ++i) {
+                if (data[i] % 7 == 0) acc ^= data[i];
+            }
+            return acc;
+        });
+}
+
+int simd_filter(const vector<int>& data) {
+    return filter_reduce<divisible_by<7>, xor_op>(data.data(), data.size());
+}
+
+int parallel_simd(const vector<int>& data, int num_threads) {
+    return parallel_reduce(data.size(), num_threads, 0, bit_xor<int>(),
+        [&](size_t start, size_t end, int acc) {
+            return filter_reduce<divisible_by<7>, xor_op>(data.data() + start, end - start, acc);
+        });
+}
+
+// Кількість елементів в одному блоці потокового конвеєра (4 МБ).
+constexpr size_t CHUNK_ELEMENTS = 1 << 20;
+
+// Обмежений набір блоків, що циркулюють між виробником і споживачами:
+// вільні -> заповнені виробником -> редуковані споживачем -> знову вільні.
+// Пам'ять виділяється один раз і не залежить від загальної кількості елементів.
+class chunk_pipeline {
+public:
+    struct chunk {
+        vector<int> data;
+        size_t size = 0;
+    };
+
+    chunk_pipeline(size_t chunks, size_t chunk_elements): storage(chunks) {
+        for (auto& c : storage) {
+            c.data.resize(chunk_elements);
+            free_list.push_back(&c);
+        }
+    }
+
+    size_t capacity_bytes() const { return storage.size() * storage[0].data.size() * sizeof(int); }
+
+    chunk* acquire() {
+        unique_lock<mutex> lk(m);
+        cv_free.wait(lk, [&] { return !free_list.empty(); });
+        chunk* c = free_list.back();
+        free_list.pop_back();
+        return c;
+    }
+
+    void submit(chunk* c) {
+        {
+            lock_guard<mutex> lk(m);
+            ready.push_back(c);
+        }
+        cv_ready.notify_one();
+    }
+
+    // nullptr, коли виробник закрив конвеєр і всі блоки розібрано.
+    chunk* take() {
+        unique_lock<mutex> lk(m);
+        cv_ready.wait(lk, [&] { return closed || !ready.empty(); });
+        if (ready.empty()) return nullptr;
+        chunk* c = ready.front();
+        ready.pop_front();
+        return c;
+    }
+
+    void release(chunk* c) {
+        {
+            lock_guard<mutex> lk(m);
+            free_list.push_back(c);
+        }
+        cv_free.notify_one();
+    }
+
+    void close() {
+        {
+            lock_guard<mutex> lk(m);
+            closed = true;
+        }
+        cv_ready.notify_all();
+    }
+
+private:
+    vector<chunk> storage;
+    mutex m;
+    condition_variable cv_free, cv_ready;
+    vector<chunk*> free_list;
+    deque<chunk*> ready;
+    bool closed = false;
+};
+
+// Виробник заповнює блоки через fill(out, n), поки споживачі редукують
+// попередні. Блоків удвічі більше, ніж споживачів, плюс два для виробника.
+template<typename Fill>
+int stream_reduce(size_t total, int consumers, Fill fill, size_t* memory_bytes = nullptr) {
+    chunk_pipeline pipe(consumers * 2 + 2, CHUNK_ELEMENTS);
+    if (memory_bytes) *memory_bytes = pipe.capacity_bytes();
 
+    vector<padded<int>> partial(consumers, padded<int>{0});
+    vector<thread> workers;
+    for (int c = 0; c < consumers; ++c) {
+        workers.emplace_back([&, c] {
+            int acc = 0;
+            while (auto* ch = pipe.take()) {
+                acc = filter_reduce<divisible_by<7>, xor_op>(ch->data.data(), ch->size, acc);
+                pipe.release(ch);
+            }
+            partial[c].value = acc;
+        });
+    }
+
+    for (size_t done = 0; done < total; ) {
+        auto* ch = pipe.acquire();
+        ch->size = min(CHUNK_ELEMENTS, total - done);
+        fill(ch->data.data(), ch->size);
+        pipe.submit(ch);
+        done += ch->size;
+    }
+    pipe.close();
+    for (auto& w : workers) w.join();
+
+    int result = 0;
+    for (const auto& p : partial) result ^= p.value;
+    return result;
+}
+
+void fill_random(int* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = rand() % 1001;
+}
+
+// XOR кратних 7 у двійковому файлі int32, відображеному в пам'ять.
+int file_reduce(const mapped_file& file, int num_threads) {
+    const int* data = reinterpret_cast<const int*>(file.data());
+    size_t count = file.size() / sizeof(int);
+    return parallel_reduce(count, num_threads, 0, bit_xor<int>(),
+        [&](size_t start, size_t end, int acc) {
+            return filter_reduce<divisible_by<7>, xor_op>(data + start, end - start, acc);
+        });
+}
+
+// Записує count випадкових int32 блоками по CHUNK_ELEMENTS.
+void write_random_file(const string& path, size_t count) {
+    ofstream out(path, ios::binary);
+    if (!out) throw runtime_error("Не вдалося створити " + path);
+    vector<int> buf(CHUNK_ELEMENTS);
+    for (size_t done = 0; done < count; ) {
+        size_t n = min(CHUNK_ELEMENTS, count - done);
+        fill_random(buf.data(), n);
+        out.write(reinterpret_cast<const char*>(buf.data()), n * sizeof(int));
+        done += n;
+    }
+}
+
+// Наївні еталони для перевірки: звичайне ділення і розгалуження.
+template<typename Op>
+int reference_reduce(const vector<int>& data, int divisor) {
+    int acc = Op::identity;
+    for (int val : data) {
+        if (val % divisor == 0) acc = Op::apply(acc, val);
+    }
+    return acc;
+}
+
+template<uint32_t D, typename Op>
+bool check_variant(const vector<int>& data, const char* name) {
+    int expected = reference_reduce<Op>(data, D);
+    int scalar = filter_reduce_scalar<divisible_by<D>, Op>(data.data(), data.size());
+    int simd = filter_reduce<divisible_by<D>, Op>(data.data(), data.size());
+    bool ok = scalar == expected && simd == expected;
+    if (!ok) {
+        cout << "ПОМИЛКА: " << name << " % " << D << ", розмір " << data.size()
+             << ": очікувалось " << expected << ", скалярно " << scalar << ", SIMD " << simd << "\n";
+    }
+    return ok;
+}
+
+// SIMD-фільтр має давати той самий результат, що й sequential(),
+// зокрема на розмірах, не кратних ширині вектора.
+bool check_simd_filter() {
+    bool ok = true;
+    for (int size : {0, 1, 7, 31, 33, 1001, 100003}) {
+        vector<int> data = generate_data(size);
+        data.push_back(INT_MAX - INT_MAX % 7);
+        // Дані з --file можуть містити від'ємні значення, зокрема INT_MIN.
+        data.push_back(-7 * (size + 1));
+        data.push_back(-(size + 2));
+        data.push_back(INT_MIN);
+        ok = (simd_filter(data) == sequential(data)) && ok;
+        ok = (parallel_simd(data, 3) == sequential(data)) && ok;
+        ok = check_variant<7, xor_op>(data, "xor") && ok;
+        ok = check_variant<3, sum_op>(data, "sum") && ok;
+        ok = check_variant<8, or_op>(data, "or") && ok;
+        ok = check_variant<10, min_op>(data, "min") && ok;
+    }
+    unsigned seed = static_cast<unsigned>(time(0));
+    srand(seed);
+    int streamed = stream_reduce(3 * CHUNK_ELEMENTS + 17, 2, fill_random);
+    srand(seed);
+    ok = (streamed == sequential(generate_data(3 * CHUNK_ELEMENTS + 17))) && ok;
+
+    cout << "Перевірка SIMD-фільтра (AVX2 " << (isaSupported(Isa::AVX2) ? "є" : "немає") << "): "
+         << (ok ? "OK" : "ПОМИЛКА") << "\n";
+    return ok;
+}
+
+template<typename F>
+void measure(const char* label, F f) {
     auto start = high_resolution_clock::now();
-    int res1 = sequential(data);
+    int res = f();
     auto end = high_resolution_clock::now();
-    cout << "Послідовно:\tXOR = " << res1
+    cout << label << "XOR = " << res
          << ", час = " << duration<double>(end - start).count() << " с\n";
+}
 
-    start = high_resolution_clock::now();
-    int res2 = parallel_mutex(data);
-    end = high_resolution_clock::now();
-    cout << "З м'ютексом:\tXOR = " << res2
-         << ", час = " << duration<double>(end - start).count() << " с\n";
+void test_size(int size, int max_threads) {
+    cout << "\nРозмір масиву: " << size << " елементів\n";
+    vector<int> data = generate_data(size);
 
-    start = high_resolution_clock::now();
-    int res3 = parallel_atomic(data);
-    end = high_resolution_clock::now();
-    cout << "З CAS:\t\tXOR = " << res3
-         << ", час = " << duration<double>(end - start).count() << " с\n";
+    measure("Послідовно:\t", [&] { return sequential(data); });
+    measure("SIMD:\t\t", [&] { return simd_filter(data); });
+
+    for (int t = 1; t <= max_threads; ++t) {
+        cout << "Потоків: " << t << "\n";
+        measure("  З м'ютексом:\t", [&] { return parallel_mutex(data, t); });
+        measure("  З CAS:\t", [&] { return parallel_atomic(data, t); });
+        measure("  fetch_xor:\t", [&] { return parallel_fetch_xor(data, t); });
+        measure("  Шардинг:\t", [&] { return parallel_sharded(data, t); });
+        measure("  Шардинг+SIMD:\t", [&] { return parallel_simd(data, t); });
+    }
 }
 
-int main() {
+void run_stream(size_t total, int consumers) {
+    cout << "\nПотокова обробка: " << total << " елементів, споживачів: " << consumers << "\n";
+    size_t memory = 0;
+    auto start = high_resolution_clock::now();
+    int res = stream_reduce(total, consumers, fill_random, &memory);
+    auto end = high_resolution_clock::now();
+    double sec = duration<double>(end - start).count();
+    cout << "XOR = " << res << ", час = " << sec << " с, "
+         << total / sec / 1e6 << " млн елементів/с, пам'ять блоків = " << memory / (1024 * 1024) << " МБ\n";
+}
+
+void run_file(const string& path, int num_threads) {
+    mapped_file file(path);
+    cout << "\nФайл " << path << ": " << file.size() / sizeof(int) << " елементів, потоків: " << num_threads << "\n";
+    auto start = high_resolution_clock::now();
+    int res = file_reduce(file, num_threads);
+    auto end = high_resolution_clock::now();
+    double sec = duration<double>(end - start).count();
+    cout << "XOR = " << res << ", час = " << sec << " с, "
+         << file.size() / sec / (1024.0 * 1024 * 1024) << " ГБ/с\n";
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
+#endif
     srand(time(0));
 
+    if (!check_simd_filter()) return 1;
+
+    int max_threads = max(1u, thread::hardware_concurrency());
+
+    // --stream N: згенерувати й обробити N елементів сталою пам'яттю;
+    // --file PATH: обробити файл int32; --make-file PATH N: створити такий файл.
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if (arg == "--stream" && i + 1 < argc) {
+                run_stream(stoull(argv[++i]), max_threads);
+                return 0;
+            }
+            if (arg == "--file" && i + 1 < argc) {
+                run_file(argv[++i], max_threads);
+                return 0;
+            }
+            if (arg == "--make-file" && i + 2 < argc) {
+                string path = argv[++i];
+                write_random_file(path, stoull(argv[++i]));
+                return 0;
+            }
+            cerr << "Невідомий параметр: " << arg << "\n";
+            return 1;
+        }
+    } catch (const exception& e) {
+        cerr << "Помилка: " << e.what() << "\n";
+        return 1;
+    }
+
     vector<int> sizes = {10000, 100000, 1000000, 10000000, 100000000};
     for (int i = 0; i < sizes.size(); ++i) {
-        test_size(sizes[i]);
+        test_size(sizes[i], max_threads);
     }
 
     return 0;
-}
\ No newline at end of file
+}
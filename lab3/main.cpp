@@ -1,193 +1,401 @@
 #include <iostream>
-#include <queue>
 #include <thread>
 #include <vector>
-#include <shared_mutex>
 #include <mutex>
-#include <condition_variable>
-#include <functional>
 #include <chrono>
-#include <atomic>
 #include <random>
+#include <string>
+#include <functional>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#define NOMINMAX
 #include <windows.h>
+#include <malloc.h>
+#endif
+
+#include "../common/thread_pool.h"
 
 using namespace std;
-using Clock = chrono::steady_clock;
-using read_write_lock = shared_mutex;
-using read_lock = shared_lock<read_write_lock>;
-using write_lock = unique_lock<read_write_lock>;
 
-template<typename F>
-class task_queue {
-    queue<F> tasks;
-    mutable read_write_lock rw;
-public:
-    bool empty() const {
-        read_lock lk(rw);
-        return tasks.empty();
-    }
+// Лічильник виділень пам'яті для --bench-alloc: заміна глобального operator new.
+// GCC не знає, що пара new/delete замінена разом, і хибно попереджає про free.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static atomic<size_t> allocations{0};
 
-    size_t size() const {
-        read_lock lk(rw);
-        return tasks.size();
-    }
+void* operator new(size_t n) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
 
-    void clear() {
-        write_lock lk(rw);
-        while (!tasks.empty()) tasks.pop();
-    }
+// Вирівняні варіанти: ними виділяють task_slab і запасний шлях unique_function.
+void* operator new(size_t n, align_val_t al) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    size_t a = static_cast<size_t>(al);
+    size_t bytes = (max<size_t>(n, 1) + a - 1) / a * a;
+#ifdef _WIN32
+    if (void* p = _aligned_malloc(bytes, a)) return p;
+#else
+    if (void* p = aligned_alloc(a, bytes)) return p;
+#endif
+    throw bad_alloc();
+}
+void operator delete(void* p, align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+void operator delete(void* p, size_t, align_val_t al) noexcept { operator delete(p, al); }
+
+// Пропускна здатність черги: producers потоків додають порожні задачі,
+// workers потоків виконують їх і засинають на event_count, коли черга пуста.
+template<typename Queue>
+double bench_queue(Queue& q, size_t cap, int producers, int workers, size_t tasks_per_producer) {
+    event_count idle;
+    atomic<bool> done{false};
+    atomic<size_t> executed{0};
 
-    bool pop(F &f) {
-        write_lock lk(rw);
-        if (tasks.empty()) return false;
-        f = move(tasks.front()); tasks.pop();
-        return true;
+    auto start = Clock::now();
+    vector<thread> ws;
+    for (int w = 0; w < workers; ++w) {
+        ws.emplace_back([&] {
+            function<void()> task;
+            while (true) {
+                if (q.pop(task)) {
+                    task();
+                    executed.fetch_add(1, memory_order_relaxed);
+                    continue;
+                }
+                if (done) break;
+                uint32_t key = idle.prepare_wait();
+                if (!q.empty() || done) {
+                    idle.cancel_wait();
+                    continue;
+                }
+                idle.wait(key);
+            }
+        });
     }
 
-    bool push(F&& f, size_t cap) {
-        write_lock lk(rw);
-        if (tasks.size() >= cap) return false;
-        tasks.push(move(f));
-        return true;
+    vector<thread> ps;
+    for (int p = 0; p < producers; ++p) {
+        ps.emplace_back([&] {
+            for (size_t i = 0; i < tasks_per_producer; ++i) {
+                function<void()> task = []{};
+                while (!q.push(move(task), cap)) {
+                    task = []{};
+                    this_thread::yield();
+                }
+                idle.notify_one();
+            }
+        });
     }
+    for (auto& t : ps) t.join();
+    done = true;
+    idle.notify_all();
+    for (auto& t : ws) t.join();
 
-    F top() const {
-        read_lock lk(rw);
-        if (tasks.empty()) throw std::runtime_error("Черга пуста");
-        return tasks.top();
+    double sec = chrono::duration<double>(Clock::now() - start).count();
+    return executed / sec;
+}
+
+void run_queue_benchmark() {
+    const int PRODUCERS = 5, WORKERS = 6;
+    const size_t CAP = 1024, TASKS = 200000;
+
+    task_queue<function<void()>> locked;
+    double oldRate = bench_queue(locked, CAP, PRODUCERS, WORKERS, TASKS);
+    mpmc_queue<function<void()>> lockFree(CAP);
+    double newRate = bench_queue(lockFree, CAP, PRODUCERS, WORKERS, TASKS);
+
+    cout << "Виробників: " << PRODUCERS << ", робочих потоків: " << WORKERS
+         << ", порожніх задач: " << PRODUCERS * TASKS << "\n";
+    cout << "task_queue (shared_mutex): " << static_cast<size_t>(oldRate) << " задач/с\n";
+    cout << "mpmc_queue (lock-free):    " << static_cast<size_t>(newRate) << " задач/с\n";
+}
+
+// Дерево задач: кожна задача глибини d > 0 породжує дві дочірні з робочого
+// потоку. У режимі work_stealing вони йдуть у локальний дек потоку.
+void spawn_tree(thread_pool& pool, int depth, atomic<size_t>& pending) {
+    if (depth == 0) {
+        pending.fetch_sub(1, memory_order_release);
+        return;
+    }
+    pending.fetch_add(1, memory_order_relaxed);
+    for (int k = 0; k < 2; ++k) {
+        // Порожнє місце в спільній черзі може закінчитися — тоді виконуємо на місці.
+        if (!pool.addTask([&pool, depth, &pending] { spawn_tree(pool, depth - 1, pending); }))
+            spawn_tree(pool, depth - 1, pending);
     }
-};
+}
 
-class thread_pool {
-public:
-    thread_pool(size_t workers = 6, size_t capacity = 15): WORKERS(workers), CAP(capacity) {
-        for(size_t i = 0; i < WORKERS; ++i)
-            workers_vec.emplace_back(&thread_pool::worker, this);
-        created = WORKERS;
+double bench_spawn(pool_mode mode, int workers, int depth, int roots) {
+    // Місткості вистачає на всі задачі, тож обидва режими виконують їх у пулі.
+    size_t total = static_cast<size_t>(roots) * ((size_t(2) << depth) - 1);
+    thread_pool pool(workers, total, nullptr, mode);
+    atomic<size_t> pending{static_cast<size_t>(roots)};
+
+    auto start = Clock::now();
+    for (int r = 0; r < roots; ++r) {
+        while (!pool.addTask([&pool, depth, &pending] { spawn_tree(pool, depth, pending); }))
+            this_thread::yield();
     }
-    ~thread_pool() { shutdown(); }
+    while (pending.load(memory_order_acquire) != 0) this_thread::yield();
+    double sec = chrono::duration<double>(Clock::now() - start).count();
 
-    void addTask(function<void()> f) {
-        attempted++;
+    pool.shutdown();
+    if (mode == pool_mode::work_stealing) pool.show_metrics();
+    return total / sec;
+}
 
-        if (!q.push(move(f), CAP)) {
-            rejected++;
-            return;
-        }
+void run_steal_benchmark() {
+    const int WORKERS = 6, DEPTH = 14, ROOTS = 8;
+    double sharedRate = bench_spawn(pool_mode::shared_queue, WORKERS, DEPTH, ROOTS);
+    double stealRate = bench_spawn(pool_mode::work_stealing, WORKERS, DEPTH, ROOTS);
 
-        accepted++;
+    cout << "Робочих потоків: " << WORKERS << ", дерев: " << ROOTS << ", глибина: " << DEPTH << "\n";
+    cout << "Спільна черга:  " << static_cast<size_t>(sharedRate) << " задач/с\n";
+    cout << "Work stealing:  " << static_cast<size_t>(stealRate) << " задач/с\n";
+}
 
-        auto now = Clock::now();
-        if (q.size() == CAP) {
-            write_lock lg(metrics_mtx);
-            if (!is_full) {
-                is_full = true;
-                full_start = now;
-            }
-        }
+// Скільки виділень пам'яті припадає на одну задачу, що пройшла через пул.
+template<size_t CAPTURE>
+double allocs_per_task(size_t tasks) {
+    thread_pool pool(6, 1024);
+    atomic<size_t> done{0};
+    array<char, CAPTURE> payload{};
 
-        cv.notify_all();
+    size_t before = allocations.load();
+    for (size_t i = 0; i < tasks; ++i) {
+        while (!pool.addTask([payload, &done] { done.fetch_add(1 + payload[0], memory_order_relaxed); }))
+            this_thread::yield();
     }
+    while (done.load() != tasks) this_thread::yield();
+    return double(allocations.load() - before) / tasks;
+}
 
-    void shutdown() {
-        stop = true;
-        cv.notify_all();
-        for(auto &t : workers_vec) {
-            if (t.joinable()) t.join();
-        }
+// Те саме для std::function у черзі mpmc_queue — як було до unique_function.
+template<size_t CAPTURE>
+double allocs_per_std_function(size_t tasks) {
+    mpmc_queue<function<void()>> q(1024);
+    size_t done = 0;
+    array<char, CAPTURE> payload{};
+
+    size_t before = allocations.load();
+    for (size_t i = 0; i < tasks; ++i) {
+        q.push([payload, &done] { done += 1 + payload[0]; }, 1024);
+        function<void()> task;
+        q.pop(task);
+        task();
     }
+    return double(allocations.load() - before) / tasks;
+}
 
-    void show_metrics() const {
-        double avgWait = waitCycles ? (totalWaitNs / static_cast<double>(waitCycles) / 1e9) : 0;
+void run_alloc_benchmark() {
+    const size_t TASKS = 100000;
+    cout << "Виділень пам'яті на задачу (" << TASKS << " задач):\n";
+    cout << "  замикання 24 Б:  std::function " << allocs_per_std_function<16>(TASKS)
+         << ", thread_pool " << allocs_per_task<16>(TASKS) << "\n";
+    cout << "  замикання 48 Б:  std::function " << allocs_per_std_function<40>(TASKS)
+         << ", thread_pool " << allocs_per_task<40>(TASKS) << "\n";
+    cout << "  замикання 136 Б: std::function " << allocs_per_std_function<128>(TASKS)
+         << ", thread_pool " << allocs_per_task<128>(TASKS) << "\n";
+}
 
-        vector<double> durations_copy;
-        {
-            read_lock lg(metrics_mtx);
-            durations_copy = full_durations;
-        }
+// Подання задач по одній через submit проти однієї пачки через submit_bulk.
+void run_submit_benchmark() {
+    const size_t TASKS = 200000;
+    thread_pool pool(6, TASKS);
+    pool.set_overflow(overflow_policy::block);
 
-        double minFull = 0, maxFull = 0;
-        if (!durations_copy.empty()) {
-            minFull = *min_element(durations_copy.begin(), durations_copy.end());
-            maxFull = *max_element(durations_copy.begin(), durations_copy.end());
-        }
+    auto start = Clock::now();
+    vector<task_future<size_t>> single;
+    single.reserve(TASKS);
+    for (size_t i = 0; i < TASKS; ++i) single.push_back(pool.submit([i] { return i; }));
+    size_t sum = 0;
+    for (auto& f : single) sum += f.get();
+    double singleSec = chrono::duration<double>(Clock::now() - start).count();
 
-        cout << "Кількість робочих потоків: " << created << "\n";
-        cout << "Спроб додати задач: " << attempted << "\n";
-        cout << "Завершено задач: " << completed << "\n";
-        cout << "Відкинуто задач: " << rejected << "\n";
-        cout << "Середній час простою потоків (с): " << avgWait << "\n";
-        cout << "Найкоротший час, коли черга була повністю заповнена (с): " << minFull << "\n";
-        cout << "Найдовший час, коли черга була повністю заповнена (с): "   << maxFull << "\n";
-    }
+    vector<function<size_t()>> jobs;
+    jobs.reserve(TASKS);
+    for (size_t i = 0; i < TASKS; ++i) jobs.push_back([i] { return i; });
+    start = Clock::now();
+    auto bulk = pool.submit_bulk(jobs.begin(), jobs.end());
+    size_t bulkSum = 0;
+    for (auto& f : bulk) bulkSum += f.get();
+    double bulkSec = chrono::duration<double>(Clock::now() - start).count();
 
-private:
-    void worker() {
-        while (true) {
-            function<void()> task;
-            {
-                unique_lock<mutex> lk(cv_m);
-                auto start_wait = Clock::now();
-                cv.wait(lk, [&]{ return stop || !q.empty(); });
-                auto end_wait = Clock::now();
-                totalWaitNs += chrono::duration_cast<chrono::nanoseconds>(end_wait - start_wait).count();
-                waitCycles++;
-            }
-            if (stop && q.empty()) break;
-
-            if (q.pop(task)) {
-                bool record = false;
-                Clock::time_point start_tp;
-                {
-                    write_lock lg(metrics_mtx);
-                    if (is_full) {
-                        is_full = false;
-                        start_tp = full_start;
-                        record = true;
-                    }
-                }
-                if (record) {
-                    auto now2 = Clock::now();
-                    double dt = chrono::duration<double>(now2 - start_tp).count();
-                    write_lock lg(metrics_mtx);
-                    full_durations.push_back(dt);
-                }
+    if (sum != bulkSum) throw runtime_error("submit і submit_bulk дали різні результати");
+    cout << "Задач: " << TASKS << "\n";
+    cout << "submit:      " << static_cast<size_t>(TASKS / singleSec) << " задач/с\n";
+    cout << "submit_bulk: " << static_cast<size_t>(TASKS / bulkSec) << " задач/с\n";
+}
+
+// Довгі задачі зі сном, як у демонстрації, у зменшеному масштабі.
+// Повертає частку відкинутих задач; rate — виконаних задач за секунду.
+double run_sleepy_load(thread_pool& pool, double& rate) {
+    const int PRODUCERS = 5, TASKS_PER_PRODUCER = 60;
+    atomic<int> accepted{0};
 
-                completed++;
-                task();
+    auto start = Clock::now();
+    vector<thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&, p] {
+            mt19937 rng(p + 1);
+            uniform_int_distribution<int> dist(50, 100);
+            for (int i = 0; i < TASKS_PER_PRODUCER; ++i) {
+                int dur = dist(rng);
+                if (pool.addTask([dur] { this_thread::sleep_for(chrono::milliseconds(dur)); })) accepted++;
+                this_thread::sleep_for(chrono::milliseconds(20));
             }
-        }
+        });
     }
+    for (auto& t : producers) t.join();
+    pool.shutdown();
+
+    double sec = chrono::duration<double>(Clock::now() - start).count();
+    rate = accepted / sec;
+    return 1.0 - double(accepted) / (PRODUCERS * TASKS_PER_PRODUCER);
+}
 
-    const size_t WORKERS;
-    const size_t CAP;
-    task_queue<function<void()>> q;
-    vector<thread> workers_vec;
+void run_elastic_benchmark() {
+    double fixedRate, elasticRate;
+    thread_pool fixed(6, 15);
+    double fixedDrop = run_sleepy_load(fixed, fixedRate);
 
-    mutex cv_m;
-    condition_variable_any cv;
-    atomic<bool> stop{false};
+    thread_pool adaptive(elastic_bounds{2, 32, chrono::milliseconds(50), chrono::milliseconds(500)}, 15);
+    double elasticDrop = run_sleepy_load(adaptive, elasticRate);
+    adaptive.show_metrics();
 
-    size_t created{0};
-    atomic<size_t> attempted{0}, accepted{0}, completed{0}, rejected{0};
+    cout << "Фіксований пул (6 потоків):  " << fixedRate << " задач/с, відкинуто "
+         << fixedDrop * 100 << "%\n";
+    cout << "Адаптивний пул (2..32):      " << elasticRate << " задач/с, відкинуто "
+         << elasticDrop * 100 << "%\n";
+}
+
+// Додаткова вартість метрик на задачу: мітка часу при поданні й три
+// гістограми (мітки початку й кінця виконання пул бере й без них).
+void run_metrics_benchmark() {
+    const size_t N = 10000000;
+    auto hists = make_unique<array<latency_histogram, 3>>();
+    mt19937 rng(1);
+    vector<uint64_t> values(4096);
+    for (auto& v : values) v = rng() % 10000000;
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < N; ++i) {
+        uint64_t v = values[i & 4095];
+        (*hists)[0].record(v);
+        (*hists)[1].record(v >> 3);
+        (*hists)[2].record(v + (v >> 3));
+    }
+    double recordNs = chrono::duration<double, nano>(Clock::now() - start).count() / N;
+
+    int64_t sink = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < N; ++i) sink += now_ns();
+    double clockNs = chrono::duration<double, nano>(Clock::now() - start).count() / N;
+
+    cout << "Три гістограми: " << recordNs << " нс, мітка часу: " << clockNs
+         << " нс, разом: " << recordNs + clockNs << " нс на задачу\n";
+    if (sink == 42) cout << "\n";
+    cout << "p50 " << (*hists)[0].read().percentile_ns(0.5) << " нс, p99.9 "
+         << (*hists)[0].read().percentile_ns(0.999) << " нс (очікувано ~5e6 і ~1e7)\n";
+}
+
+// Пакетні задачі перевантажують пул, а кожні 5 мс подається коротка
+// задача, чутлива до затримки. Повертає гістограму її очікування.
+latency_histogram::snapshot latency_under_load(bool usePriority, int& dropped) {
+    thread_pool pool(4, 256);
+    atomic<bool> done{false};
+    // Задачі виконують різні потоки пулу, тож запис атомарний.
+    auto sensitive = make_unique<latency_histogram>();
+
+    thread batch([&] {
+        while (!done) {
+            if (!pool.addTask([] { this_thread::sleep_for(chrono::milliseconds(1)); },
+                              {task_priority::batch}))
+                this_thread::yield();
+        }
+    });
 
-    mutable read_write_lock metrics_mtx;
-    bool is_full{false};
-    Clock::time_point full_start;
-    vector<double> full_durations;
+    task_options urgent{usePriority ? task_priority::critical : task_priority::batch};
+    for (int i = 0; i < 200; ++i) {
+        int64_t submitted = now_ns();
+        if (!pool.addTask([&, submitted] { sensitive->record_concurrent(static_cast<uint64_t>(now_ns() - submitted)); },
+                          urgent))
+            dropped++;
+        this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    done = true;
+    batch.join();
+    pool.shutdown();
+    return sensitive->read();
+}
 
-    atomic<uint64_t> totalWaitNs{0}, waitCycles{0};
-};
+void run_priority_benchmark() {
+    for (bool usePriority : {false, true}) {
+        int dropped = 0;
+        auto h = latency_under_load(usePriority, dropped);
+        cout << (usePriority ? "Смуга critical:      " : "Спільна смуга batch: ")
+             << "p50 " << h.percentile_ns(0.5) / 1e3 << " мкс, p99 " << h.percentile_ns(0.99) / 1e3
+             << " мкс (виконано " << h.count << ", відкинуто " << dropped << ")\n";
+    }
+}
 
-int main() {
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
+#endif
+
+    if (argc > 1 && string(argv[1]) == "--bench-queue") {
+        run_queue_benchmark();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-alloc") {
+        run_alloc_benchmark();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-submit") {
+        run_submit_benchmark();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-elastic") {
+        run_elastic_benchmark();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-metrics") {
+        run_metrics_benchmark();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-priority") {
+        run_priority_benchmark();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-steal") {
+        run_steal_benchmark();
+        return 0;
+    }
 
     const int PRODUCERS = 5;
     const int TASKS_PER_PRODUCER = 10;
     mutex cout_mtx;
 
     thread_pool pool(6, 15);
+    // Виробник, що натрапив на заповнену чергу, чекає на місце до 3 с,
+    // і лише потім задачу буде відкинуто.
+    pool.set_overflow(overflow_policy::block_for, chrono::seconds(3));
 
+    vector<vector<task_future<int>>> results(PRODUCERS);
     vector<thread> producers;
     for(int p = 0; p < PRODUCERS; ++p) {
         producers.emplace_back([&, p](){
@@ -196,20 +404,43 @@ int main() {
             for(int i = 0; i < TASKS_PER_PRODUCER; ++i) {
                 int id = p * TASKS_PER_PRODUCER + i + 1;
                 int dur = dist(rng);
-                pool.addTask([id, dur, &cout_mtx](){
+                results[p].push_back(pool.submit([id, dur, &cout_mtx](){
                     { lock_guard<mutex> lg(cout_mtx);
                       cout << "Завдання #" << id << " виконується " << dur << " сек\n"; }
                     this_thread::sleep_for(chrono::seconds(dur));
                     { lock_guard<mutex> lg(cout_mtx);
                       cout << "Завдання #" << id << " завершено\n"; }
-                });
+                    return dur;
+                }));
                 this_thread::sleep_for(chrono::milliseconds(500));
             }
         });
     }
     for(auto &t : producers) t.join();
 
+    int done = 0, dropped = 0, busySeconds = 0;
+    for (auto& list : results) {
+        for (auto& f : list) {
+            try {
+                busySeconds += f.get();
+                ++done;
+            } catch (const exception&) {
+                ++dropped;
+            }
+        }
+    }
+    cout << "Виконано задач: " << done << ", відкинуто: " << dropped
+         << ", сумарна тривалість роботи (с): " << busySeconds << "\n";
+
     pool.shutdown();
     pool.show_metrics();
+
+    // --metrics ФАЙЛ: знімок метрик у форматі Prometheus (або JSON для *.json).
+    if (argc > 2 && string(argv[1]) == "--metrics") {
+        string path = argv[2];
+        bool json = path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        pool.write_metrics(path, json ? metrics_format::json : metrics_format::prometheus);
+        cout << "Метрики записано у " << path << "\n";
+    }
     return 0;
-}
\ No newline at end of file
+}
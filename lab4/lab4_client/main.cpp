@@ -1,20 +1,44 @@
-#include <winsock2.h>
-#include <windows.h>
+#define NOMINMAX
+#include "../../common/net.h"
 #include <iostream>
 #include <vector>
 #include <thread>
 #include <random>
+#include <string>
+#include <ctime>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <future>
+
+#include "../../common/random_matrix.h"
+#include "../../common/row_codec.h"
+#include "../../common/column_max.h"
 
 using namespace std;
 
 constexpr uint16_t CMD_INIT   = 0x01;
 constexpr uint16_t CMD_START  = 0x02;
 constexpr uint16_t CMD_STATUS = 0x03;
+constexpr uint16_t CMD_INIT_EX = 0x04;
+constexpr uint16_t CMD_RESULT = 0x05;
 constexpr uint16_t RSP_INIT   = 0x11;
 constexpr uint16_t RSP_START  = 0x12;
 constexpr uint16_t RSP_STATUS = 0x13;
+constexpr uint16_t RSP_RESULT = 0x15;
+
+constexpr uint32_t INIT_LITTLE_ENDIAN = 0x01;
+constexpr uint32_t INIT_STREAM_MAX = 0x02;
+constexpr uint32_t INIT_ENCODING_SHIFT = 8;
+constexpr uint32_t INIT_BITS_SHIFT = 16;
 
 mutex cout_mutex;
+bool quiet = false;
+bool legacyInit = false;
+bool streamInit = false;
+string encodingArg = "auto";
+atomic<int> succeeded{0}, failed{0};
 
 int sendAll(SOCKET sock, const char* buf, int len) {
     int total = 0;
@@ -36,61 +60,164 @@ int recvAll(SOCKET sock, char* buf, int len) {
     return total;
 }
 
-vector<vector<int>> createRandomMatrix(int n) {
-    vector<vector<int>> mat(n, vector<int>(n));
-    for (int i = 0; i < n; ++i) {
-        for (int j = 0; j < n; ++j) {
-            mat[i][j] = rand() % 1001;
+bool hostLittleEndian() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+struct WireFormat {
+    RowEncoding enc = RowEncoding::U32;
+    uint32_t bits = 32;
+};
+
+// Кодування за діапазоном значень: до 15 бітів — щільне пакування,
+// 16 — по два байти, інакше без стиснення.
+WireFormat chooseEncoding(const Matrix<uint32_t>& mat, const string& wanted) {
+    uint32_t maxValue = 0;
+    for (size_t i = 0; i < mat.rows(); ++i)
+        for (size_t j = 0; j < mat.cols(); ++j) maxValue = max(maxValue, mat(i, j));
+    uint32_t bits = bitsFor(maxValue);
+    string pick = wanted;
+    if (pick == "auto") pick = bits < 16 ? "bitpack" : bits == 16 ? "u16" : "u32";
+    if (pick == "bitpack") return {RowEncoding::BitPack, bits};
+    if (pick == "u16" && bits <= 16) return {RowEncoding::U16, 16};
+    if (pick == "u16" || pick == "u32") return {RowEncoding::U32, 32};
+    throw runtime_error("Невідоме кодування: " + wanted);
+}
+
+const char* encodingName(RowEncoding enc) {
+    switch (enc) {
+    case RowEncoding::U16:     return "u16";
+    case RowEncoding::BitPack: return "bitpack";
+    default:                   return "u32";
+    }
+}
+
+// CMD_INIT_EX. Без кодування заголовок і всі рядки йдуть прямо з пам'яті
+// матриці пачками writev, без копіювання; на little-endian хості байти не
+// переставляються. Закодовані рядки пакуються в два блоки по черзі: поки
+// окремий потік відправляє один, у другий кодується наступний. З --stream сервер рахує максимуми
+// стовпців уже під час прийому. Відправляє рядки [rowBegin, rowEnd),
+// повертає кількість байтів даних.
+size_t sendMatrix(SOCKET sock, const Matrix<uint32_t>& mat, WireFormat wf, size_t rowBegin, size_t rowEnd) {
+    size_t rows = rowEnd - rowBegin;
+    bool le = hostLittleEndian();
+    uint32_t flags = (le ? INIT_LITTLE_ENDIAN : 0) | (streamInit ? INIT_STREAM_MAX : 0) |
+                     (uint32_t(wf.enc) << INIT_ENCODING_SHIFT);
+    if (wf.enc == RowEncoding::BitPack) flags |= wf.bits << INIT_BITS_SHIFT;
+    uint16_t cmd = htons(CMD_INIT_EX);
+    uint32_t hdr[3] = {htonl(static_cast<uint32_t>(rows)), htonl(static_cast<uint32_t>(mat.cols())), htonl(flags)};
+    vector<net_buffer> bufs;
+    bufs.reserve(rows + 2);
+    bufs.push_back({reinterpret_cast<const char*>(&cmd), sizeof(cmd)});
+    bufs.push_back({reinterpret_cast<const char*>(hdr), sizeof(hdr)});
+
+    size_t rowBytes = encodedRowBytes(wf.enc, mat.cols(), wf.bits);
+    if (wf.enc != RowEncoding::U32) {
+        if (!send_gather(sock, bufs.data(), bufs.size())) throw runtime_error("відправка не вдалася");
+        size_t batch = max<size_t>(1, (256 << 10) / max<size_t>(rowBytes, 1));
+        vector<uint8_t> blocks[2] = {vector<uint8_t>(batch * rowBytes), vector<uint8_t>(batch * rowBytes)};
+        future<bool> sending;
+        size_t cur = 0;
+        for (size_t i = rowBegin; i < rowEnd; i += batch, cur ^= 1) {
+            size_t k = min(batch, rowEnd - i);
+            // blocks[cur] відправлено два кроки тому й уже дочекано.
+            for (size_t r = 0; r < k; ++r)
+                encodeRow(wf.enc, mat.row(i + r), mat.cols(), wf.bits, blocks[cur].data() + r * rowBytes);
+            if (sending.valid() && !sending.get()) throw runtime_error("відправка не вдалася");
+            const char* data = reinterpret_cast<const char*>(blocks[cur].data());
+            int len = static_cast<int>(k * rowBytes);
+            sending = async(launch::async, [sock, data, len] { return sendAll(sock, data, len) != SOCKET_ERROR; });
         }
+        if (sending.valid() && !sending.get()) throw runtime_error("відправка не вдалася");
+        return rows * rowBytes;
+    }
+
+    vector<uint32_t> converted;
+    if (le) {
+        for (size_t i = rowBegin; i < rowEnd; ++i)
+            bufs.push_back({reinterpret_cast<const char*>(mat.row(i)), rowBytes});
+    } else {
+        converted.resize(rows * mat.cols());
+        for (size_t i = 0; i < rows; ++i)
+            for (size_t j = 0; j < mat.cols(); ++j) converted[i * mat.cols() + j] = htonl(mat(rowBegin + i, j));
+        bufs.push_back({reinterpret_cast<const char*>(converted.data()), converted.size() * sizeof(uint32_t)});
     }
+    if (!send_gather(sock, bufs.data(), bufs.size())) throw runtime_error("відправка не вдалася");
+    return rows * rowBytes;
+}
+
+// Старий CMD_INIT: елементи в мережевому порядку, рядок за рядком.
+void sendMatrixLegacy(SOCKET sock, const Matrix<uint32_t>& mat) {
+    uint32_t N = static_cast<uint32_t>(mat.rows());
+    uint16_t cmd = htons(CMD_INIT);
+    sendAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
+    uint32_t netN = htonl(N);
+    sendAll(sock, reinterpret_cast<char*>(&netN), sizeof(netN));
+    vector<uint32_t> row(N);
+    for (uint32_t i = 0; i < N; ++i) {
+        for (uint32_t j = 0; j < N; ++j) row[j] = htonl(mat(i, j));
+        if (sendAll(sock, reinterpret_cast<char*>(row.data()), static_cast<int>(N * sizeof(uint32_t))) == SOCKET_ERROR)
+            throw runtime_error("відправка не вдалася");
+    }
+}
+
+fork_join_executor genPool;
+
+Matrix<uint32_t> createRandomMatrix(int n, uint64_t seed) {
+    Matrix<uint32_t> mat(n, n);
+    fillRandomMatrix(mat, seed, 1001, genPool);
     return mat;
 }
 
-void run_client(int client_id, const string& server_ip, int port) {
+SOCKET connectTo(const string& server_ip, int port) {
     SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (sock == INVALID_SOCKET) {
-        lock_guard<mutex> lock(cout_mutex);
-        cerr << "[Клієнт " << client_id << "] socket не вдався" << endl;
-        return;
+    if (sock == INVALID_SOCKET) throw runtime_error("socket не вдався");
+    sockaddr_in serverAddr{};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = inet_addr(server_ip.c_str());
+    serverAddr.sin_port = htons(static_cast<uint16_t>(port));
+    if (connect(sock, reinterpret_cast<sockaddr*>(&serverAddr), sizeof(serverAddr)) == SOCKET_ERROR) {
+        closesocket(sock);
+        throw runtime_error("не вдалося під'єднатися до " + server_ip + ":" + to_string(port));
     }
+    return sock;
+}
 
-    {
+void run_client(int client_id, const string& server_ip, int port, uint64_t seed, int N) {
+    if (!quiet) {
         lock_guard<mutex> lock(cout_mutex);
         cout << "[Клієнт " << client_id << "] під'єднується до сервера " << server_ip << ":" << port << "..." << endl;
     }
 
-    sockaddr_in serverAddr{};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = inet_addr(server_ip.c_str());
-    serverAddr.sin_port = htons(port);
-    if (connect(sock, reinterpret_cast<sockaddr*>(&serverAddr), sizeof(serverAddr)) == SOCKET_ERROR) {
+    SOCKET sock;
+    try {
+        sock = connectTo(server_ip, port);
+    } catch (const exception& e) {
+        failed++;
         lock_guard<mutex> lock(cout_mutex);
-        cerr << "[Клієнт " << client_id << "] не вдалося під'єднатися" << endl;
-        closesocket(sock);
+        cerr << "[Клієнт " << client_id << "] " << e.what() << endl;
         return;
     }
 
     try {
-        const int N = 10000;
-        auto matrix = createRandomMatrix(N);
+        auto matrix = createRandomMatrix(N, seed);
 
         // INIT
-        uint16_t cmd = htons(CMD_INIT);
-        sendAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
-        uint32_t netN = htonl(N);
-        sendAll(sock, reinterpret_cast<char*>(&netN), sizeof(netN));
-        for (int i = 0; i < N; ++i) {
-            for (int j = 0; j < N; ++j) {
-                uint32_t v = htonl(static_cast<uint32_t>(matrix[i][j]));
-                sendAll(sock, reinterpret_cast<char*>(&v), sizeof(v));
-            }
-        }
-        recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
-        if (ntohs(cmd) != RSP_INIT) throw runtime_error("INIT не вдався");
+        auto t1 = chrono::steady_clock::now();
+        WireFormat wf = chooseEncoding(matrix, encodingArg);
+        size_t wireBytes = matrix.rows() * matrix.cols() * sizeof(uint32_t);
+        if (legacyInit) sendMatrixLegacy(sock, matrix);
+        else wireBytes = sendMatrix(sock, matrix, wf, 0, matrix.rows());
+        uint16_t cmd;
+        if (recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd)) <= 0 || ntohs(cmd) != RSP_INIT)
+            throw runtime_error("INIT не вдався");
+        double upload = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
 
-        {
+        if (!quiet) {
             lock_guard<mutex> lock(cout_mutex);
-            cout << "[Клієнт " << client_id << "] INIT підтверджено" << endl;
+            cout << "[Клієнт " << client_id << "] INIT підтверджено за " << upload << " сек ("
+                 << (legacyInit ? "u32" : encodingName(wf.enc)) << ", " << wireBytes / 1024 << " КБ)" << endl;
         }
 
         // START
@@ -100,11 +227,11 @@ void run_client(int client_id, const string& server_ip, int port) {
             uint32_t netT = htonl(T);
             sendAll(sock, reinterpret_cast<char*>(&netT), sizeof(netT));
 
-            recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
-            if (ntohs(cmd) != RSP_START) throw runtime_error("START не вдався");
             double dur;
-            recvAll(sock, reinterpret_cast<char*>(&dur), sizeof(dur));
-            {
+            if (recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd)) <= 0 || ntohs(cmd) != RSP_START ||
+                recvAll(sock, reinterpret_cast<char*>(&dur), sizeof(dur)) <= 0)
+                throw runtime_error("START не вдався");
+            if (!quiet) {
                 lock_guard<mutex> lock(cout_mutex);
                 cout << "[Клієнт " << client_id << "] потоки = " << T
                      << ", час виконання: " << dur << " сек" << endl;
@@ -114,15 +241,17 @@ void run_client(int client_id, const string& server_ip, int port) {
         // STATUS
         cmd = htons(CMD_STATUS);
         sendAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
-        recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
-        if (ntohs(cmd) != RSP_STATUS) throw runtime_error("STATUS не вдався");
+        if (recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd)) <= 0 || ntohs(cmd) != RSP_STATUS)
+            throw runtime_error("STATUS не вдався");
+        succeeded++;
 
-        {
+        if (!quiet) {
             lock_guard<mutex> lock(cout_mutex);
             cout << "[Клієнт " << client_id << "] STATUS підтверджено сервером" << endl;
         }
 
     } catch (const exception& e) {
+        failed++;
         lock_guard<mutex> lock(cout_mutex);
         cerr << "[Клієнт " << client_id << "] Помилка: " << e.what() << endl;
     }
@@ -130,23 +259,159 @@ void run_client(int client_id, const string& server_ip, int port) {
     closesocket(sock);
 }
 
-int main() {
+struct Endpoint {
+    string ip;
+    int port;
+};
+
+// Один шард координатора: рядки [rowBegin, rowEnd) на свій сервер,
+// у відповідь — максимуми стовпців цих рядків (RSP_RESULT).
+vector<uint32_t> runShard(const Endpoint& ep, const Matrix<uint32_t>& mat, WireFormat wf,
+                          size_t rowBegin, size_t rowEnd, uint32_t T) {
+    SOCKET sock = connectTo(ep.ip, ep.port);
+    vector<uint32_t> part;
+    try {
+        sendMatrix(sock, mat, wf, rowBegin, rowEnd);
+        uint16_t cmd;
+        if (recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd)) <= 0 || ntohs(cmd) != RSP_INIT)
+            throw runtime_error("INIT не вдався");
+
+        cmd = htons(CMD_RESULT);
+        uint32_t netT = htonl(T);
+        sendAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
+        sendAll(sock, reinterpret_cast<char*>(&netT), sizeof(netT));
+        uint32_t n;
+        if (recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd)) <= 0 || ntohs(cmd) != RSP_RESULT ||
+            recvAll(sock, reinterpret_cast<char*>(&n), sizeof(n)) <= 0 || ntohl(n) != mat.cols())
+            throw runtime_error("RESULT не вдався");
+        part.resize(mat.cols());
+        if (!part.empty() && recvAll(sock, reinterpret_cast<char*>(part.data()), static_cast<int>(part.size() * sizeof(uint32_t))) <= 0)
+            throw runtime_error("RESULT не вдався");
+        for (uint32_t& v : part) v = ntohl(v);
+
+        cmd = htons(CMD_STATUS);
+        sendAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
+        recvAll(sock, reinterpret_cast<char*>(&cmd), sizeof(cmd));
+    } catch (...) {
+        closesocket(sock);
+        throw;
+    }
+    closesocket(sock);
+    return part;
+}
+
+// Ділить рядки матриці між серверами, кожен шард у своєму потоці, й
+// об'єднує часткові максимуми. Повертає час у секундах.
+double runCoordinator(const vector<Endpoint>& endpoints, const Matrix<uint32_t>& mat, WireFormat wf,
+                      uint32_t T, vector<uint32_t>& merged) {
+    size_t K = endpoints.size();
+    vector<vector<uint32_t>> parts(K);
+    vector<string> errors(K);
+    auto t1 = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (size_t k = 0; k < K; ++k) {
+        size_t rowBegin = mat.rows() * k / K, rowEnd = mat.rows() * (k + 1) / K;
+        // Сервер не приймає порожню матрицю; шардів більше, ніж рядків, — лишні без роботи.
+        if (rowBegin == rowEnd) continue;
+        threads.emplace_back([&, k, rowBegin, rowEnd] {
+            try {
+                parts[k] = runShard(endpoints[k], mat, wf, rowBegin, rowEnd, T);
+            } catch (const exception& e) {
+                errors[k] = e.what();
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (size_t k = 0; k < K; ++k)
+        if (!errors[k].empty())
+            throw runtime_error("шард " + to_string(k) + " (" + endpoints[k].ip + ":" + to_string(endpoints[k].port) + "): " + errors[k]);
+    merged.assign(mat.cols(), 0);
+    for (const auto& part : parts)
+        for (size_t j = 0; j < part.size(); ++j) merged[j] = max(merged[j], part[j]);
+    return chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+}
+
+// --shards 127.0.0.1:1234,127.0.0.1:1235: порівняння одного сервера з K.
+int runShardBenchmark(const vector<Endpoint>& endpoints, int N, uint64_t seed) {
+    auto matrix = createRandomMatrix(N, seed);
+    WireFormat wf = chooseEncoding(matrix, encodingArg);
+    vector<uint32_t> expected(matrix.cols());
+    columnMaxStrip(matrix, 0, matrix.cols(), expected.data());
+
+    vector<uint32_t> single, sharded;
+    double t1 = runCoordinator({endpoints.front()}, matrix, wf, 16, single);
+    double tk = runCoordinator(endpoints, matrix, wf, 16, sharded);
+    bool ok = single == expected && sharded == expected;
+
+    cout << "Координатор: N = " << N << ", кодування " << encodingName(wf.enc) << endl;
+    cout << "  K = 1: " << t1 << " сек" << endl;
+    cout << "  K = " << endpoints.size() << ": " << tk << " сек, прискорення " << t1 / tk << endl;
+    cout << "  Результат " << (ok ? "збігається" : "НЕ збігається") << " з локальним обчисленням" << endl;
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2,2), &wsa) != 0) {
-        cerr << "WSAStartup не вдався" << endl;
+#endif
+    unique_ptr<socket_runtime> net;
+    try {
+        net = make_unique<socket_runtime>();
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
         return 1;
     }
 
     string server_ip = "127.0.0.1";
     int port = 1234;
+    int clients = 2;
+    int N = 10000;
+    uint64_t seed = static_cast<uint64_t>(time(nullptr));
+    string shards;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seed = stoull(argv[++i]);
+        else if (arg == "--clients" && i + 1 < argc) clients = stoi(argv[++i]);
+        else if (arg == "--size" && i + 1 < argc) N = stoi(argv[++i]);
+        else if (arg == "--quiet") quiet = true;
+        else if (arg == "--legacy-init") legacyInit = true;
+        else if (arg == "--stream") streamInit = true;
+        else if (arg == "--shards" && i + 1 < argc) shards = argv[++i];
+        else if (arg == "--encoding" && i + 1 < argc) encodingArg = argv[++i];
+    }
+    cout << "Зерно генератора: " << seed << endl;
 
-    thread c1(run_client, 1, server_ip, port);
-    thread c2(run_client, 2, server_ip, port);
+    if (!shards.empty()) {
+        vector<Endpoint> endpoints;
+        size_t pos = 0;
+        while (pos <= shards.size()) {
+            size_t comma = shards.find(',', pos);
+            string item = shards.substr(pos, comma == string::npos ? string::npos : comma - pos);
+            size_t colon = item.rfind(':');
+            if (colon == string::npos) endpoints.push_back({server_ip, stoi(item)});
+            else endpoints.push_back({item.substr(0, colon), stoi(item.substr(colon + 1))});
+            if (comma == string::npos) break;
+            pos = comma + 1;
+        }
+        try {
+            return runShardBenchmark(endpoints, N, seed);
+        } catch (const exception& e) {
+            cerr << "Координатор: " << e.what() << endl;
+            return 1;
+        }
+    }
 
-    c1.join();
-    c2.join();
+    // Навантажувальний тест: --clients 1000 --size 64 --quiet тримає тисячу
+    // одночасних з'єднань із сервером.
+    auto t1 = chrono::steady_clock::now();
+    vector<thread> threads;
+    threads.reserve(clients);
+    for (int id = 1; id <= clients; ++id)
+        threads.emplace_back(run_client, id, server_ip, port, seed, N);
+    for (auto& t : threads) t.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
 
-    WSACleanup();
-    return 0;
-}
\ No newline at end of file
+    cout << "Клієнтів: " << clients << ", успішно: " << succeeded << ", з помилкою: " << failed
+         << ", загальний час: " << elapsed << " сек" << endl;
+    return failed ? 1 : 0;
+}
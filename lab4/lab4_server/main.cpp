@@ -1,36 +1,65 @@
-#include <winsock2.h>
-#include <windows.h>
+#define NOMINMAX
+#include "../../common/net.h"
 #include <iostream>
 #include <vector>
 #include <thread>
 #include <stdexcept>
 #include <chrono>
 #include <mutex>
+#include <memory>
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <condition_variable>
+#include <functional>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "../../common/column_max.h"
+#include "../../common/parallel_for.h"
+#include "../../common/thread_pool.h"
+#include "../../common/row_codec.h"
 
 using namespace std;
 
 constexpr uint16_t CMD_INIT   = 0x01;
 constexpr uint16_t CMD_START  = 0x02;
 constexpr uint16_t CMD_STATUS = 0x03;
+constexpr uint16_t CMD_INIT_EX = 0x04;
+constexpr uint16_t CMD_RESULT = 0x05;
 constexpr uint16_t RSP_INIT   = 0x11;
 constexpr uint16_t RSP_START  = 0x12;
 constexpr uint16_t RSP_STATUS = 0x13;
+constexpr uint16_t RSP_RESULT = 0x15;
+constexpr uint16_t RSP_ERROR  = 0x1F;   // запит відхилено, з'єднання закривається
+
+// Слово прапорців CMD_INIT_EX: біти 0..7 — прапорці, 8..15 — RowEncoding,
+// 16..21 — кількість бітів на значення для RowEncoding::BitPack.
+constexpr uint32_t INIT_LITTLE_ENDIAN = 0x01;   // елементи в little-endian, а не в мережевому порядку
+constexpr uint32_t INIT_STREAM_MAX = 0x02;      // рахувати максимуми стовпців уже під час прийому
+constexpr uint32_t INIT_ENCODING_SHIFT = 8;
+constexpr uint32_t INIT_BITS_SHIFT = 16;
 
 mutex cout_mutex;
+bool quiet = false;
+// Найбільша матриця, яку сервер погодиться прийняти (--max-mb).
+size_t maxMatrixBytes = size_t(2) << 30;
+fork_join_executor computePool;
+// Згортка рядків, що надходять у потоковому режимі INIT.
+thread_pool foldPool(max(1u, thread::hardware_concurrency()), 1 << 12);
 
 void printError(const char* msg) {
     lock_guard<mutex> lock(cout_mutex);
-    cerr << msg << " не вдався через помилку: " << WSAGetLastError() << endl;
+    cerr << msg << " не вдався через помилку: " << net_error() << endl;
 }
 
-void recvAll(SOCKET sock, char* buf, int len) {
-    int received = 0;
-    while (received < len) {
-        int r = recv(sock, buf + received, len - received, 0);
-        if (r < 0) throw runtime_error("recv не вдався");
-        if (r == 0) throw runtime_error("З'єднання роз'єднано клієнтом");
-        received += r;
-    }
+void logLine(const string& line) {
+    if (quiet) return;
+    lock_guard<mutex> lock(cout_mutex);
+    cout << line << endl;
 }
 
 void sendAll(SOCKET sock, const char* buf, int len) {
@@ -42,120 +71,679 @@ void sendAll(SOCKET sock, const char* buf, int len) {
     }
 }
 
-void parallelColumnMax(const vector<vector<uint32_t>>& mat, uint32_t N, vector<uint32_t>& result, uint32_t start, uint32_t end) {
-    for (uint32_t j = start; j < end; ++j) {
-        uint32_t mx = mat[0][j];
-        for (uint32_t i = 1; i < N; ++i) {
-            if (mat[i][j] > mx) mx = mat[i][j];
-        }
-        result[j] = mx;
-    }
+void parallelColumnMax(const Matrix<uint32_t>& mat, vector<uint32_t>& result, uint32_t start, uint32_t end) {
+    vector<uint32_t> acc(end - start);
+    columnMaxStrip(mat, start, end, acc.data());
+    copy(acc.begin(), acc.end(), result.begin() + start);
 }
 
-void computeColumnMaxParallel(const vector<vector<uint32_t>>& mat, uint32_t N, vector<uint32_t>& result, uint32_t T) {
+void computeColumnMaxParallel(const Matrix<uint32_t>& mat, uint32_t N, vector<uint32_t>& result, uint32_t T) {
     result.assign(N, 0);
-    vector<thread> threads;
-    threads.reserve(T);
-
-    uint32_t base = N / T;
-    uint32_t rem  = N % T;
-    uint32_t start = 0;
-    for (uint32_t t = 0; t < T; ++t) {
-        uint32_t extra = (t < rem) ? 1 : 0;
-        uint32_t end   = start + base + extra;
-        threads.emplace_back(parallelColumnMax, cref(mat), N, ref(result), start, end);
-        start = end;
-    }
-    for (auto &th : threads) th.join();
+    uint32_t grain = (N + T - 1) / max<uint32_t>(T, 1);
+    computePool.parallel_for(0, N, grain, [&](size_t start, size_t end) {
+        parallelColumnMax(mat, result, static_cast<uint32_t>(start), static_cast<uint32_t>(end));
+    });
 }
 
-void handleClient(SOCKET client) {
-    {
-        lock_guard<mutex> lock(cout_mutex);
-        cout << "[Сервер] Клієнт під'єднався: " << client << endl;
+// Максимуми стовпців, що рахуються блоками рядків у foldPool, поки
+// наступні блоки ще приймаються. Блоки об'єднуються в довільному порядку.
+// Задачі тримають і згортку, і матрицю, тож з'єднання може закритися або
+// почати новий INIT, не чекаючи їх; onBlock викликається після кожного блоку.
+class ColumnFold : public enable_shared_from_this<ColumnFold> {
+public:
+    ColumnFold(size_t cols, function<void()> onBlock): maxima(cols, 0), onBlock(move(onBlock)) {}
+
+    // Рядки [from, to) вже прийняті й більше не змінюються.
+    // false, якщо черга foldPool заповнена — тоді блок не взято.
+    bool add(const shared_ptr<const Matrix<uint32_t>>& mat, size_t from, size_t to) {
+        {
+            lock_guard<mutex> lk(m);
+            ++pending;
+        }
+        bool queued = foldPool.addTask([self = shared_from_this(), mat, from, to] {
+            self->fold(*mat, from, to);
+            self->finishBlock();
+        });
+        if (!queued) {
+            lock_guard<mutex> lk(m);
+            --pending;
+        }
+        return queued;
     }
-    try {
-        uint16_t cmd;
-        uint32_t N = 0;
-        vector<vector<uint32_t>> mat;
-        vector<uint32_t> result;
-        bool dataReady = false;
 
-        while (true) {
-            recvAll(client, reinterpret_cast<char*>(&cmd), sizeof(cmd));
-            cmd = ntohs(cmd);
-            if (cmd == CMD_INIT) {
-                recvAll(client, reinterpret_cast<char*>(&N), sizeof(N));
-                N = ntohl(N);
-                mat.assign(N, vector<uint32_t>(N));
-                for (uint32_t i = 0; i < N; ++i) {
-                    for (uint32_t j = 0; j < N; ++j) {
-                        uint32_t v;
-                        recvAll(client, reinterpret_cast<char*>(&v), sizeof(v));
-                        mat[i][j] = ntohl(v);
-                    }
-                }
-                dataReady = true;
-                {
-                    lock_guard<mutex> lock(cout_mutex);
-                    cout << "[Сервер] INIT отримано: N = " << N << endl;
-                }
-                uint16_t rsp = htons(RSP_INIT);
-                sendAll(client, reinterpret_cast<char*>(&rsp), sizeof(rsp));
-
-            } else if (cmd == CMD_START) {
-                if (!dataReady) throw runtime_error("Дані не ініціалізовано");
-                uint32_t netT;
-                recvAll(client, reinterpret_cast<char*>(&netT), sizeof(netT));
-                uint32_t T = ntohl(netT);
-                {
-                    lock_guard<mutex> lock(cout_mutex);
-                    cout << "[Сервер] START отрмано: потоки = " << T << endl;
-                }
+    // Згортка в потоці виклику.
+    void fold(const Matrix<uint32_t>& mat, size_t from, size_t to) {
+        vector<uint32_t> acc(mat.cols(), 0);
+        columnMaxRows(mat, from, to, 0, mat.cols(), acc.data());
+        lock_guard<mutex> lk(m);
+        for (size_t j = 0; j < acc.size(); ++j) maxima[j] = max(maxima[j], acc[j]);
+    }
 
-                auto t1 = chrono::high_resolution_clock::now();
-                computeColumnMaxParallel(mat, N, result, T);
-                for (uint32_t i = 0; i < N; ++i) {
-                    mat[i][i] = result[i];
-                }
-                auto t2 = chrono::high_resolution_clock::now();
-                double dur = chrono::duration<double>(t2 - t1).count();
+    size_t inFlight() {
+        lock_guard<mutex> lk(m);
+        return pending;
+    }
+
+    const vector<uint32_t>& wait() {
+        unique_lock<mutex> lk(m);
+        idle.wait(lk, [&] { return pending == 0; });
+        return maxima;
+    }
 
-                uint16_t rsp = htons(RSP_START);
-                sendAll(client, reinterpret_cast<char*>(&rsp), sizeof(rsp));
-                sendAll(client, reinterpret_cast<char*>(&dur), sizeof(dur));
+private:
+    void finishBlock() {
+        {
+            lock_guard<mutex> lk(m);
+            if (--pending == 0) idle.notify_all();
+        }
+        if (onBlock) onBlock();
+    }
 
-            } else if (cmd == CMD_STATUS) {
-                if (!dataReady) throw runtime_error("Дані не ініціалізовано");
-                {
-                    lock_guard<mutex> lock(cout_mutex);
-                    cout << "[Сервер] запит STATUS, відправка результатів..." << endl;
-                }
-                uint16_t rsp = htons(RSP_STATUS);
-                sendAll(client, reinterpret_cast<char*>(&rsp), sizeof(rsp));
-                break;
+    mutex m;
+    condition_variable idle;
+    size_t pending = 0;
+    vector<uint32_t> maxima;
+    function<void()> onBlock;
+};
+
+// Стан протоколу одного клієнта без прив'язки до способу вводу-виводу.
+// Драйвер питає want(), куди читати далі, читає туди скільки є байтів
+// і повідомляє received(n). Відповіді накопичуються у вихідному буфері.
+// START і RESULT не обчислюються тут: драйвер забирає запит через takeStart(),
+// викликає compute() деінде і повертає тривалість у finishStart().
+class Connection {
+public:
+    explicit Connection(SOCKET sock): sock(sock) {}
+
+    SOCKET socket() const { return sock; }
+
+    // Обробка START і RESULT: максимуми стовпців. START записує їх на
+    // діагональ, RESULT лишає матрицю як є й повертає вектор клієнту.
+    // У потоковому режимі максимуми вже пораховані під час прийому,
+    // лишається дочекатися останніх блоків. Повертає тривалість у секундах.
+    double compute(uint32_t T) {
+        auto t1 = chrono::high_resolution_clock::now();
+        if (streamed) {
+            // Рядки, які foldPool не прийняв, згортаються тут, у потоці обчислення.
+            if (foldFrom < mat->rows()) fold->fold(*mat, foldFrom, mat->rows());
+            result = fold->wait();
+        }
+        else computeColumnMaxParallel(*mat, static_cast<uint32_t>(mat->cols()), result, T);
+        if (!wantResult) {
+            for (size_t i = 0; i < min(mat->rows(), mat->cols()); ++i) (*mat)(i, i) = result[i];
+        }
+        auto t2 = chrono::high_resolution_clock::now();
+        return chrono::duration<double>(t2 - t1).count();
+    }
+
+    // Куди читати наступні байти; {nullptr, 0}, якщо зараз читати не треба.
+    pair<char*, size_t> want() {
+        switch (st) {
+        case State::Command:
+        case State::InitSize:
+        case State::InitHeader:
+        case State::StartThreads:
+            return {header + got, headerSize() - got};
+        case State::InitRows:
+            if (enc != RowEncoding::U32)
+                return {reinterpret_cast<char*>(stage.data()) + got, stagedRows() * encodedRow - got};
+            // Рядки без доповнення лежать підряд — тоді решту матриці
+            // можна приймати одним recv просто в її пам'ять.
+            if (mat->stride() == mat->cols())
+                return {reinterpret_cast<char*>(mat->row(row)) + got, (mat->rows() - row) * rowBytes() - got};
+            return {reinterpret_cast<char*>(mat->row(row)) + got, rowBytes() - got};
+        default:
+            return {nullptr, 0};
+        }
+    }
+
+    void received(size_t n) {
+        got += n;
+        if (st == State::InitRows && enc != RowEncoding::U32) {
+            size_t k = stagedRows();
+            if (got < k * encodedRow) return;
+            for (size_t i = 0; i < k; ++i)
+                decodeRow(enc, stage.data() + i * encodedRow, mat->cols(), bits, mat->row(row + i));
+            got = 0;
+            row += k;
+            if (streamed) foldReceived(true);
+            if (row == mat->rows()) finishInit();
+            return;
+        }
+        if (st == State::InitRows) {
+            while (got >= rowBytes()) {
+                toHostOrder(mat->row(row), mat->cols());
+                got -= rowBytes();
+                ++row;
+                if (streamed) foldReceived(row == mat->rows());
+                if (row == mat->rows()) return finishInit();
+            }
+            return;
+        }
+        if (got < headerSize()) return;
+        got = 0;
+        switch (st) {
+        case State::Command:      onCommand(); break;
+        case State::InitSize:     onInitSize(); break;
+        case State::InitHeader:   onInitHeader(); break;
+        case State::StartThreads: onStartThreads(); break;
+        default: break;
+        }
+    }
+
+    bool takeStart(uint32_t& threads) {
+        if (st != State::Computing || startTaken) return false;
+        startTaken = true;
+        threads = startThreads;
+        return true;
+    }
+
+    void finishStart(double dur) {
+        if (wantResult) {
+            // RSP_RESULT, кількість стовпців, максимуми — усе в мережевому порядку.
+            uint16_t rsp = htons(RSP_RESULT);
+            append(&rsp, sizeof(rsp));
+            uint32_t n = htonl(static_cast<uint32_t>(result.size()));
+            append(&n, sizeof(n));
+            for (uint32_t& v : result) v = htonl(v);
+            append(result.data(), result.size() * sizeof(uint32_t));
+        } else {
+            uint16_t rsp = htons(RSP_START);
+            append(&rsp, sizeof(rsp));
+            append(&dur, sizeof(dur));
+        }
+        st = State::Command;
+    }
+
+    const char* pending() const { return out.data() + outSent; }
+    size_t pendingSize() const { return out.size() - outSent; }
+    void sent(size_t n) {
+        outSent += n;
+        if (outSent == out.size()) {
+            out.clear();
+            outSent = 0;
+        }
+    }
+
+    bool reading() const {
+        return st == State::Command || st == State::InitSize || st == State::InitHeader ||
+               (st == State::InitRows && !foldStalled) || st == State::StartThreads;
+    }
+
+    // Драйвер дізнається про кожен завершений блок згортки (з потоку foldPool)
+    // і у своєму потоці викликає foldProgress().
+    void setFoldNotify(function<void()> fn) { foldNotify = move(fn); }
+
+    // Блок згортки завершився: повторити відкладений блок і, можливо, знову читати.
+    void foldProgress() {
+        if (st != State::InitRows || !streamed) return;
+        foldStalled = false;
+        foldReceived(false);
+    }
+    bool computing() const { return st == State::Computing; }
+    // Після STATUS або помилки з'єднання закривається, щойно буфер відправлено.
+    bool finished() const { return st == State::Closing; }
+
+    void fail(const string& why) {
+        {
+            lock_guard<mutex> lock(cout_mutex);
+            cerr << "[Сервер] Помилка клієнта " << sock << ": " << why << endl;
+        }
+        st = State::Closing;
+    }
 
-            } else {
+private:
+    enum class State { Command, InitSize, InitHeader, InitRows, StartThreads, Computing, Closing };
+
+    static constexpr size_t MAX_FOLD_BLOCKS = 8;
+
+    size_t headerSize() const {
+        if (st == State::Command) return sizeof(uint16_t);
+        if (st == State::InitHeader) return 3 * sizeof(uint32_t);
+        return sizeof(uint32_t);
+    }
+
+    size_t rowBytes() const { return mat->cols() * sizeof(uint32_t); }
+
+    // Закодовані рядки приймаються пачкою в проміжний буфер і розкодовуються
+    // в матрицю, щойно пачка надійшла повністю.
+    size_t stagedRows() const { return min(batchRows, mat->rows() - row); }
+
+    // Віддає прийняті рядки на згортку блоками приблизно по 256 КБ. Поки
+    // в роботі MAX_FOLD_BLOCKS блоків або пул відмовив, читання призупиняється
+    // до наступного foldProgress(). Якщо відмовив, а своїх блоків у роботі
+    // немає, читання триває: решту рядків догорне compute().
+    void foldReceived(bool force) {
+        if (row == foldFrom || (!force && (row - foldFrom) * rowBytes() < (256 << 10))) return;
+        if (fold->add(mat, foldFrom, row)) {
+            foldFrom = row;
+            foldStalled = fold->inFlight() >= MAX_FOLD_BLOCKS;
+        } else {
+            foldStalled = fold->inFlight() > 0;
+        }
+    }
+
+    static bool hostLittleEndian() {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+    }
+
+    // Приведення прийнятого рядка до порядку байтів хоста. Якщо клієнт
+    // домовився про little-endian і хост такий самий, нічого не робиться.
+    void toHostOrder(uint32_t* r, size_t n) const {
+        if (!littleEndian) {
+            for (size_t j = 0; j < n; ++j) r[j] = ntohl(r[j]);
+        } else if (!hostLittleEndian()) {
+            for (size_t j = 0; j < n; ++j)
+                r[j] = (r[j] >> 24) | ((r[j] >> 8) & 0xFF00) | ((r[j] << 8) & 0xFF0000) | (r[j] << 24);
+        }
+    }
+
+    void append(const void* p, size_t n) {
+        const char* c = static_cast<const char*>(p);
+        out.insert(out.end(), c, c + n);
+    }
+
+    void onCommand() {
+        uint16_t cmd;
+        memcpy(&cmd, header, sizeof(cmd));
+        cmd = ntohs(cmd);
+        if (cmd == CMD_INIT) {
+            st = State::InitSize;
+        } else if (cmd == CMD_INIT_EX) {
+            st = State::InitHeader;
+        } else if (cmd == CMD_START || cmd == CMD_RESULT) {
+            if (!dataReady) return fail("Дані не ініціалізовано");
+            wantResult = cmd == CMD_RESULT;
+            st = State::StartThreads;
+        } else if (cmd == CMD_STATUS) {
+            if (!dataReady) return fail("Дані не ініціалізовано");
+            logLine("[Сервер] запит STATUS, відправка результатів...");
+            uint16_t rsp = htons(RSP_STATUS);
+            append(&rsp, sizeof(rsp));
+            st = State::Closing;
+        } else {
+            {
                 lock_guard<mutex> lock(cout_mutex);
                 cerr << "[Сервер] Незрозуміла команда: " << cmd << endl;
-                break;
             }
+            st = State::Closing;
         }
+    }
+
+    void onInitSize() {
+        uint32_t N;
+        memcpy(&N, header, sizeof(N));
+        N = ntohl(N);
+        littleEndian = false;
+        streamed = false;
+        enc = RowEncoding::U32;
+        beginRows(N, N);
+    }
+
+    // CMD_INIT_EX: рядки, стовпці, прапорці — далі рядки матриці цілком.
+    void onInitHeader() {
+        uint32_t h[3];
+        memcpy(h, header, sizeof(h));
+        uint32_t flags = ntohl(h[2]);
+        uint32_t encoding = (flags >> INIT_ENCODING_SHIFT) & 0xFF;
+        bits = (flags >> INIT_BITS_SHIFT) & 0x3F;
+        if ((flags & 0xFF & ~(INIT_LITTLE_ENDIAN | INIT_STREAM_MAX)) || (flags >> 22) || encoding > uint32_t(RowEncoding::BitPack))
+            return fail("Невідомі прапорці INIT: " + to_string(flags));
+        enc = static_cast<RowEncoding>(encoding);
+        if (enc == RowEncoding::BitPack && (bits == 0 || bits > 32))
+            return fail("Неправильна кількість бітів: " + to_string(bits));
+        littleEndian = (flags & INIT_LITTLE_ENDIAN) != 0;
+        streamed = (flags & INIT_STREAM_MAX) != 0;
+        beginRows(ntohl(h[0]), ntohl(h[1]));
+        if (enc != RowEncoding::U32 && st == State::InitRows) {
+            encodedRow = encodedRowBytes(enc, mat->cols(), bits);
+            batchRows = max<size_t>(1, (256 << 10) / encodedRow);
+            stage.resize(min(batchRows, mat->rows()) * encodedRow);
+        }
+    }
+
+    void beginRows(uint32_t rows, uint32_t cols) {
+        // Розміри приходять з мережі: перевіряються до будь-якого виділення.
+        if (rows == 0 || cols == 0 || uint64_t(cols) * sizeof(uint32_t) > maxMatrixBytes / rows)
+            return reject("Неприпустимий розмір матриці: " + to_string(rows) + " x " + to_string(cols));
+        // Блоки згортки попередньої матриці тримають її самі, тож не чекаємо їх.
+        mat = make_shared<Matrix<uint32_t>>(rows, cols);
+        row = 0;
+        foldFrom = 0;
+        foldStalled = false;
+        fold = streamed ? make_shared<ColumnFold>(cols, foldNotify) : nullptr;
+        st = State::InitRows;
+    }
+
+    // Відповідь RSP_ERROR і закриття після її відправки.
+    void reject(const string& why) {
+        uint16_t rsp = htons(RSP_ERROR);
+        append(&rsp, sizeof(rsp));
+        fail(why);
+    }
+
+    void finishInit() {
+        dataReady = true;
+        vector<uint8_t>().swap(stage);
+        if (mat->rows() == mat->cols()) logLine("[Сервер] INIT отримано: N = " + to_string(mat->rows()));
+        else logLine("[Сервер] INIT отримано: " + to_string(mat->rows()) + " x " + to_string(mat->cols()));
+        uint16_t rsp = htons(RSP_INIT);
+        append(&rsp, sizeof(rsp));
+        st = State::Command;
+    }
+
+    void onStartThreads() {
+        uint32_t T;
+        memcpy(&T, header, sizeof(T));
+        startThreads = ntohl(T);
+        logLine(string("[Сервер] ") + (wantResult ? "RESULT" : "START") + " отрмано: потоки = " + to_string(startThreads));
+        st = State::Computing;
+        startTaken = false;
+    }
+
+    SOCKET sock;
+    State st = State::Command;
+    char header[3 * sizeof(uint32_t)];
+    size_t got = 0;
+
+    shared_ptr<Matrix<uint32_t>> mat = make_shared<Matrix<uint32_t>>();
+    size_t row = 0;
+    bool littleEndian = false;
+    RowEncoding enc = RowEncoding::U32;
+    uint32_t bits = 32;
+    size_t encodedRow = 0;
+    size_t batchRows = 1;
+    vector<uint8_t> stage;
+    bool streamed = false;
+    size_t foldFrom = 0;
+    bool foldStalled = false;
+    shared_ptr<ColumnFold> fold;
+    function<void()> foldNotify;
+    bool dataReady = false;
+    uint32_t startThreads = 0;
+    bool startTaken = false;
+    bool wantResult = false;
+    vector<uint32_t> result;
+
+    vector<char> out;
+    size_t outSent = 0;
+};
+
+// Потік на з'єднання з блокуючими recv/send (збірка для Windows).
+void handleClient(SOCKET client) {
+    logLine("[Сервер] Клієнт під'єднався: " + to_string(client));
+    Connection conn(client);
+    try {
+        while (!conn.finished()) {
+            uint32_t T;
+            if (conn.takeStart(T)) conn.finishStart(conn.compute(T));
+            if (conn.pendingSize()) {
+                sendAll(client, conn.pending(), static_cast<int>(conn.pendingSize()));
+                conn.sent(conn.pendingSize());
+            }
+            auto [buf, len] = conn.want();
+            if (!len) continue;
+            int r = recv(client, buf, static_cast<int>(min<size_t>(len, INT32_MAX)), 0);
+            if (r < 0) throw runtime_error("recv не вдався");
+            if (r == 0) throw runtime_error("З'єднання роз'єднано клієнтом");
+            conn.received(static_cast<size_t>(r));
+        }
+        if (conn.pendingSize()) sendAll(client, conn.pending(), static_cast<int>(conn.pendingSize()));
     } catch (const exception& e) {
         lock_guard<mutex> lock(cout_mutex);
         cerr << "[Сервер] Помилка клієнта " << client << ": " << e.what() << endl;
     }
     closesocket(client);
-    {
-        lock_guard<mutex> lock(cout_mutex);
-        cout << "[Сервер] Клієнт " << client << " від'єднався" << endl;
-    }
+    logLine("[Сервер] Клієнт " + to_string(client) + " від'єднався");
 }
 
-int main() {
+#ifdef __linux__
+// Сервер на epoll: фіксована кількість потоків-реакторів, кожен зі своїм
+// epoll, обслуговує неблокуючі з'єднання. Обчислення START виконується в
+// окремому пулі, тож мережеві потоки ніколи не чекають на обчислення;
+// результат повертається реактору через eventfd. Так само через eventfd
+// реактор дізнається про завершені блоки потокової згортки.
+class EpollServer {
+public:
+    EpollServer(SOCKET listenSock, size_t reactorCount, size_t jobThreads)
+        : listenSock(listenSock), jobs(jobThreads, 1 << 16) {
+        set_nonblocking(listenSock);
+        for (size_t i = 0; i < reactorCount; ++i) {
+            auto r = make_unique<Reactor>();
+            r->ep = epoll_create1(EPOLL_CLOEXEC);
+            r->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (r->ep < 0 || r->wake < 0) throw runtime_error("epoll/eventfd не вдався");
+            // EPOLLEXCLUSIVE: про нове з'єднання дізнається один реактор, а не всі.
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+            ev.data.u64 = LISTEN_TAG;
+            if (epoll_ctl(r->ep, EPOLL_CTL_ADD, listenSock, &ev) != 0) throw runtime_error("epoll_ctl не вдався");
+            ev.events = EPOLLIN;
+            ev.data.u64 = WAKE_TAG;
+            epoll_ctl(r->ep, EPOLL_CTL_ADD, r->wake, &ev);
+            reactors.push_back(move(r));
+        }
+    }
+
+    void run() {
+        for (auto& r : reactors) r->th = thread(&EpollServer::loop, this, r.get());
+        for (auto& r : reactors) r->th.join();
+    }
+
+private:
+    static constexpr uint64_t LISTEN_TAG = ~uint64_t(0);
+    static constexpr uint64_t WAKE_TAG = ~uint64_t(0) - 1;
+    // Скільки байтів читати з одного з'єднання за подію, щоб інші не чекали.
+    static constexpr size_t READ_BUDGET = 1 << 20;
+
+    struct Client {
+        Connection conn;
+        uint64_t id;
+        uint32_t events = 0;
+        explicit Client(SOCKET s, uint64_t id): conn(s), id(id) {}
+    };
+
+    struct Completion {
+        shared_ptr<Client> client;
+        double dur;
+    };
+
+    struct Reactor {
+        int ep = -1;
+        int wake = -1;
+        thread th;
+        unordered_map<uint64_t, shared_ptr<Client>> clients;
+        uint64_t nextId = 0;
+        mutex doneMutex;
+        vector<Completion> done;
+        vector<weak_ptr<Client>> folded;
+    };
+
+    void loop(Reactor* r) {
+        epoll_event events[256];
+        while (true) {
+            int n = epoll_wait(r->ep, events, 256, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                printError("epoll_wait");
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == LISTEN_TAG) acceptAll(r);
+                else if (tag == WAKE_TAG) drainCompletions(r);
+                else {
+                    auto it = r->clients.find(tag);
+                    // Копія: close() видаляє запис із таблиці, поки onEvent ще працює.
+                    if (it != r->clients.end()) onEvent(r, shared_ptr<Client>(it->second), events[i].events);
+                }
+            }
+        }
+    }
+
+    void acceptAll(Reactor* r) {
+        while (true) {
+            SOCKET s = accept4(listenSock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (s == INVALID_SOCKET) {
+                if (!net_would_block() && errno != EINTR) printError("accept");
+                return;
+            }
+            int one = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            auto c = make_shared<Client>(s, r->nextId++);
+            logLine("[Сервер] Клієнт під'єднався: " + to_string(s));
+            r->clients.emplace(c->id, c);
+            // weak_ptr: згортка належить з'єднанню, сильне посилання дало б цикл.
+            c->conn.setFoldNotify([this, r, weak = weak_ptr<Client>(c)] {
+                {
+                    lock_guard<mutex> lk(r->doneMutex);
+                    r->folded.push_back(weak);
+                }
+                wake(r);
+            });
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.u64 = c->id;
+            c->events = ev.events;
+            epoll_ctl(r->ep, EPOLL_CTL_ADD, s, &ev);
+        }
+    }
+
+    void onEvent(Reactor* r, const shared_ptr<Client>& c, uint32_t events) {
+        Connection& conn = c->conn;
+        if (events & EPOLLERR) return close(r, c);
+        // Клієнт пішов, поки ми нічого від нього не чекаємо (наприклад, під час
+        // обчислення): з рівневими подіями EPOLLRDHUP інакше приходив би безкінечно.
+        if ((events & (EPOLLRDHUP | EPOLLHUP)) && !conn.reading()) return close(r, c);
+        try {
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+                size_t budget = READ_BUDGET;
+                while (budget && conn.reading()) {
+                    auto [buf, len] = conn.want();
+                    ssize_t got = recv(conn.socket(), buf, min(len, budget), 0);
+                    if (got > 0) {
+                        conn.received(static_cast<size_t>(got));
+                        budget -= min<size_t>(budget, static_cast<size_t>(got));
+                    } else if (got == 0) {
+                        return close(r, c);
+                    } else if (net_would_block()) {
+                        break;
+                    } else if (errno != EINTR) {
+                        throw runtime_error("recv не вдався");
+                    }
+                }
+            }
+            uint32_t T;
+            if (conn.takeStart(T)) submitStart(r, c, T);
+            flush(r, c);
+        } catch (const exception& e) {
+            conn.fail(e.what());
+            close(r, c);
+        }
+    }
+
+    void submitStart(Reactor* r, const shared_ptr<Client>& c, uint32_t T) {
+        bool queued = jobs.addTask([this, r, c, T] {
+            double dur = c->conn.compute(T);
+            {
+                lock_guard<mutex> lk(r->doneMutex);
+                r->done.push_back({c, dur});
+            }
+            wake(r);
+        });
+        if (!queued) c->conn.fail("черга обчислень заповнена");
+    }
+
+    void wake(Reactor* r) {
+        uint64_t one = 1;
+        if (write(r->wake, &one, sizeof(one)) < 0) printError("eventfd write");
+    }
+
+    void drainCompletions(Reactor* r) {
+        uint64_t count;
+        while (read(r->wake, &count, sizeof(count)) > 0) {}
+        vector<Completion> done;
+        vector<weak_ptr<Client>> folded;
+        {
+            lock_guard<mutex> lk(r->doneMutex);
+            done.swap(r->done);
+            folded.swap(r->folded);
+        }
+        for (auto& w : folded) {
+            shared_ptr<Client> c = w.lock();
+            if (!c || !r->clients.count(c->id)) continue;
+            c->conn.foldProgress();
+            // Читання могло бути призупинене, поки згортка відставала.
+            onEvent(r, c, EPOLLIN);
+        }
+        for (auto& d : done) {
+            if (!r->clients.count(d.client->id)) continue;
+            d.client->conn.finishStart(d.dur);
+            // Команди, що прийшли під час обчислення, ще лежать у сокеті.
+            onEvent(r, d.client, EPOLLIN);
+        }
+    }
+
+    // Відправляє, скільки приймає сокет, і оновлює підписку на події.
+    void flush(Reactor* r, const shared_ptr<Client>& c) {
+        Connection& conn = c->conn;
+        while (conn.pendingSize()) {
+            ssize_t s = send(conn.socket(), conn.pending(), conn.pendingSize(), MSG_NOSIGNAL);
+            if (s > 0) conn.sent(static_cast<size_t>(s));
+            else if (s < 0 && net_would_block()) break;
+            else if (s < 0 && errno == EINTR) continue;
+            else return close(r, c);
+        }
+        if (conn.finished() && !conn.pendingSize()) return close(r, c);
+
+        uint32_t want = EPOLLRDHUP;
+        if (conn.reading()) want |= EPOLLIN;
+        if (conn.pendingSize()) want |= EPOLLOUT;
+        if (want != c->events) {
+            epoll_event ev{};
+            ev.events = want;
+            ev.data.u64 = c->id;
+            epoll_ctl(r->ep, EPOLL_CTL_MOD, conn.socket(), &ev);
+            c->events = want;
+        }
+    }
+
+    void close(Reactor* r, const shared_ptr<Client>& c) {
+        SOCKET s = c->conn.socket();
+        epoll_ctl(r->ep, EPOLL_CTL_DEL, s, nullptr);
+        closesocket(s);
+        logLine("[Сервер] Клієнт " + to_string(s) + " від'єднався");
+        // Якщо START ще рахується, задача тримає свою копію shared_ptr.
+        r->clients.erase(c->id);
+    }
+
+    SOCKET listenSock;
+    thread_pool jobs;
+    vector<unique_ptr<Reactor>> reactors;
+};
+#endif
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2,2), &wsa) != 0) {
+#endif
+    size_t reactors = max(1u, thread::hardware_concurrency());
+    size_t jobThreads = 2;
+    uint16_t port = 1234;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--reactors" && i + 1 < argc) reactors = stoul(argv[++i]);
+        else if (arg == "--jobs" && i + 1 < argc) jobThreads = stoul(argv[++i]);
+        else if (arg == "--port" && i + 1 < argc) port = static_cast<uint16_t>(stoul(argv[++i]));
+        else if (arg == "--max-mb" && i + 1 < argc) maxMatrixBytes = size_t(stoull(argv[++i])) << 20;
+        else if (arg == "--quiet") quiet = true;
+    }
+
+    unique_ptr<socket_runtime> net;
+    try {
+        net = make_unique<socket_runtime>();
+    } catch (const exception&) {
         printError("WSAStartup");
         return 1;
     }
@@ -163,27 +751,40 @@ int main() {
     SOCKET listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (listenSock == INVALID_SOCKET) {
         printError("socket");
-        WSACleanup();
         return 1;
     }
 
+    int reuse = 1;
+    setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port = htons(1234);
-    if (bind(listenSock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR ||
+    addr.sin_port = htons(port);
+    if (::bind(listenSock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR ||
         listen(listenSock, SOMAXCONN) == SOCKET_ERROR) {
         printError("bind/listen");
         closesocket(listenSock);
-        WSACleanup();
         return 1;
     }
 
     {
         lock_guard<mutex> lock(cout_mutex);
-        cout << "[Сервер] Працює на порті 1234..." << endl;
+        cout << "[Сервер] Працює на порті " << port << "..." << endl;
     }
 
+#ifdef __linux__
+    {
+        lock_guard<mutex> lock(cout_mutex);
+        cout << "[Сервер] epoll: реакторів " << reactors << ", потоків обчислення " << jobThreads << endl;
+    }
+    try {
+        EpollServer(listenSock, reactors, jobThreads).run();
+    } catch (const exception& e) {
+        lock_guard<mutex> lock(cout_mutex);
+        cerr << "[Сервер] " << e.what() << endl;
+    }
+#else
     while (true) {
         SOCKET client = accept(listenSock, nullptr, nullptr);
         if (client == INVALID_SOCKET) {
@@ -192,8 +793,8 @@ int main() {
         }
         thread(handleClient, client).detach();
     }
+#endif
 
     closesocket(listenSock);
-    WSACleanup();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,85 @@
+# Тримає багато одночасних keep-alive з'єднань із сервером lab5 і
+# рахує пропускну здатність. Приклад: python conn_bench.py --connections 10000
+import argparse
+import asyncio
+import resource
+import time
+
+REQUEST = b"GET /home.html HTTP/1.1\r\nHost: localhost\r\n\r\n"
+
+
+async def read_response(reader):
+    head = await reader.readuntil(b"\r\n\r\n")
+    length = 0
+    for line in head.split(b"\r\n"):
+        if line.lower().startswith(b"content-length:"):
+            length = int(line.split(b":", 1)[1])
+    await reader.readexactly(length)
+    return head.startswith(b"HTTP/1.1 200")
+
+
+async def client(host, port, requests, opened, start, stats):
+    try:
+        reader, writer = await asyncio.open_connection(host, port)
+    except OSError:
+        stats["failed"] += 1
+        opened.release()
+        return
+    opened.release()
+    # Усі з'єднання відкриті одночасно, перш ніж піде перший запит.
+    await start.wait()
+    try:
+        for _ in range(requests):
+            writer.write(REQUEST)
+            if await read_response(reader):
+                stats["ok"] += 1
+            else:
+                stats["failed"] += 1
+    except (OSError, asyncio.IncompleteReadError):
+        stats["failed"] += 1
+    writer.close()
+
+
+def server_threads(pid):
+    with open(f"/proc/{pid}/status") as f:
+        for line in f:
+            if line.startswith("Threads:"):
+                return int(line.split()[1])
+    return None
+
+
+async def main():
+    p = argparse.ArgumentParser()
+    p.add_argument("--host", default="127.0.0.1")
+    p.add_argument("--port", type=int, default=8080)
+    p.add_argument("--connections", type=int, default=10000)
+    p.add_argument("--requests", type=int, default=10, help="запитів на з'єднання")
+    p.add_argument("--pid", type=int, help="PID сервера, щоб показати кількість його потоків")
+    args = p.parse_args()
+
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+
+    stats = {"ok": 0, "failed": 0}
+    opened = asyncio.Semaphore(0)
+    start = asyncio.Event()
+    tasks = [asyncio.create_task(client(args.host, args.port, args.requests, opened, start, stats))
+             for _ in range(args.connections)]
+    for _ in range(args.connections):
+        await opened.acquire()
+    print(f"Відкрито з'єднань: {args.connections - stats['failed']}")
+    if args.pid:
+        print(f"Потоків сервера: {server_threads(args.pid)}")
+
+    t = time.perf_counter()
+    start.set()
+    await asyncio.gather(*tasks)
+    elapsed = time.perf_counter() - t
+    print(f"Успішних відповідей: {stats['ok']}, помилок: {stats['failed']}")
+    print(f"Час: {elapsed:.2f} с, {stats['ok'] / elapsed:.0f} запитів/с")
+    if args.pid:
+        print(f"Потоків сервера: {server_threads(args.pid)}")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -12,4 +12,44 @@ class WindowsStaticUser(HttpUser):
 #Код для перевірки помилки неіснуючого сайту
 #    @task
 #    def page404(self):
-#        self.client.get("/page404.html")
\ No newline at end of file
+#        self.client.get("/page404.html")
+
+
+# Перше завантаження: браузер приймає стиснені варіанти.
+class CompressedFirstLoadUser(HttpUser):
+
+    @task
+    def home(self):
+        self.client.get("/home.html", headers={"Accept-Encoding": "gzip, br"}, name="/home.html [стиснено]")
+
+    @task
+    def page(self):
+        self.client.get("/page.html", headers={"Accept-Encoding": "gzip, br"}, name="/page.html [стиснено]")
+
+
+# Повторне завантаження: умовний GET з ETag, сервер відповідає 304 без тіла.
+class ConditionalRepeatUser(HttpUser):
+
+    def on_start(self):
+        self.etags = {}
+
+    def conditional_get(self, path):
+        headers = {"Accept-Encoding": "gzip, br"}
+        if path in self.etags:
+            headers["If-None-Match"] = self.etags[path]
+        with self.client.get(path, headers=headers, name=path + " [умовний]", catch_response=True) as r:
+            if r.status_code == 304:
+                r.success()
+            elif r.status_code == 200:
+                self.etags[path] = r.headers.get("ETag")
+                r.success()
+            else:
+                r.failure(f"неочікуваний код {r.status_code}")
+
+    @task
+    def home(self):
+        self.conditional_get("/home.html")
+
+    @task
+    def page(self):
+        self.conditional_get("/page.html")
@@ -1,117 +1,958 @@
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#include <windows.h>
+#include "../common/net.h"
+#include "../common/mapped_file.h"
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <filesystem>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+#include <sys/stat.h>
+
+// Стиснені варіанти сторінок будуються, якщо доступні бібліотеки
+// (на Linux: -lz -lbrotlienc); без них сервер віддає лише оригінали.
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define LAB5_HAVE_GZIP 1
+#endif
+#if __has_include(<brotli/encode.h>)
+#include <brotli/encode.h>
+#define LAB5_HAVE_BROTLI 1
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <list>
+#endif
 
 using namespace std;
 
 #define PORT 8080
 const string PAGE_DIR = "pages";
+const size_t MAX_REQUESTS_PER_CONNECTION = 100;
+const size_t MAX_HEADER_BYTES = 8192;
+const chrono::seconds IDLE_TIMEOUT(5);
+// Файли, не менші за поріг, не копіюються в кеш, а відображаються в
+// пам'ять і на Linux відправляються через sendfile.
+size_t sendfileThreshold = 64 << 10;
 
-void sendResponse(SOCKET clientSock, const string& status, const string& contentType, const string& body) {
+string buildHead(const string& status, const string& contentType, size_t length, bool keepAlive,
+                 const string& extra = "") {
     ostringstream oss;
     oss << "HTTP/1.1 " << status << "\r\n"
-        << "Content-Length: " << body.size() << "\r\n"
+        << "Content-Length: " << length << "\r\n"
         << "Content-Type: "  << contentType << "\r\n"
-        << "Connection: close\r\n\r\n"
-        << body;
-    auto resp = oss.str();
-    send(clientSock, resp.c_str(), (int)resp.size(), 0);
+        << extra
+        << (keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    return oss.str();
 }
 
-void handleClient(SOCKET clientSock) {
-    char buffer[4096];
-    int bytes = recv(clientSock, buffer, sizeof(buffer) - 1, 0);
-    if (bytes <= 0) {
-        closesocket(clientSock);
-        return;
+string buildResponse(const string& status, const string& contentType, const string& body, bool keepAlive,
+                     const string& extra = "") {
+    return buildHead(status, contentType, body.size(), keepAlive, extra) + body;
+}
+
+// Дата у форматі HTTP (RFC 7231), наприклад "Sun, 06 Nov 1994 08:49:37 GMT".
+string httpDate(time_t t) {
+    tm g;
+#ifdef _WIN32
+    gmtime_s(&g, &t);
+#else
+    gmtime_r(&t, &g);
+#endif
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &g);
+    return buf;
+}
+
+// Розбір HTTP-дати в трьох форматах, які має приймати отримувач (RFC 7231, 7.1.1.1):
+// IMF-fixdate, застарілий RFC 850 і asctime().
+bool parseHttpDate(const string& s, time_t& out) {
+    static const char* const MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char mon[4] = {};
+    int day, year, hour, minute, second;
+    if (sscanf(s.c_str(), "%*3s, %d %3s %d %d:%d:%d GMT", &day, mon, &year, &hour, &minute, &second) != 6 &&
+        sscanf(s.c_str(), "%*[^,], %d-%3s-%d %d:%d:%d GMT", &day, mon, &year, &hour, &minute, &second) != 6 &&
+        sscanf(s.c_str(), "%*3s %3s %d %d:%d:%d %d", mon, &day, &hour, &minute, &second, &year) != 6)
+        return false;
+    const char* m = strlen(mon) == 3 ? strstr(MONTHS, mon) : nullptr;
+    if (!m || (m - MONTHS) % 3) return false;
+    if (year < 100) year += year < 70 ? 2000 : 1900;
+    tm t{};
+    t.tm_year = year - 1900;
+    t.tm_mon = static_cast<int>((m - MONTHS) / 3);
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = minute;
+    t.tm_sec = second;
+#ifdef _WIN32
+    out = _mkgmtime(&t);
+#else
+    out = timegm(&t);
+#endif
+    return out != time_t(-1);
+}
+
+#ifdef LAB5_HAVE_GZIP
+string gzipCompress(const string& data) {
+    z_stream zs{};
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return {};
+    string out(deflateBound(&zs, static_cast<uLong>(data.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : string();
+}
+#endif
+
+#ifdef LAB5_HAVE_BROTLI
+string brotliCompress(const string& data) {
+    size_t size = BrotliEncoderMaxCompressedSize(data.size());
+    if (!size) return {};
+    string out(size, '\0');
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data.size(),
+                               reinterpret_cast<const uint8_t*>(data.data()), &size,
+                               reinterpret_cast<uint8_t*>(&out[0])))
+        return {};
+    out.resize(size);
+    return out;
+}
+#endif
+
+bool equalsIgnoreCase(const string& a, const char* b) {
+    size_t n = strlen(b);
+    if (a.size() != n) return false;
+    for (size_t i = 0; i < n; ++i)
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+    return true;
+}
+
+bool containsToken(const string& value, const char* token) {
+    string v = value;
+    for (char& c : v) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return v.find(token) != string::npos;
+}
+
+string trim(const string& s) {
+    size_t b = s.find_first_not_of(" \t"), e = s.find_last_not_of(" \t");
+    return b == string::npos ? string() : s.substr(b, e - b + 1);
+}
+
+// Чи дозволяє Accept-Encoding кодування name (з q > 0 або через "*").
+bool acceptsEncoding(const string& header, const char* name) {
+    size_t pos = 0;
+    while (pos <= header.size()) {
+        size_t comma = header.find(',', pos);
+        string item = header.substr(pos, comma == string::npos ? string::npos : comma - pos);
+        size_t semi = item.find(';');
+        string coding = trim(item.substr(0, semi));
+        if (equalsIgnoreCase(coding, name) || coding == "*") {
+            if (semi == string::npos) return true;
+            string param = trim(item.substr(semi + 1));
+            return !(param.compare(0, 2, "q=") == 0 && atof(param.c_str() + 2) <= 0);
+        }
+        if (comma == string::npos) break;
+        pos = comma + 1;
     }
-    buffer[bytes] = '\0';
+    return false;
+}
 
-    istringstream req(buffer);
+struct HttpRequest {
     string method, path, version;
-    req >> method >> path >> version;
-
-    if (method != "GET") {
-        sendResponse(clientSock, "405 Method Not Allowed",
-                     "text/plain", "Method Not Allowed");
-        closesocket(clientSock);
-        return;
-    }
-
-    if (path == "/") path = "/home.html";
-    string filePath = PAGE_DIR + path;
-
-    ifstream ifs(filePath, ios::binary);
-    if (!ifs) {
-        string body =
-            "<!DOCTYPE html>"
-            "<html><head><meta charset=\"utf-8\">"
-            "<title>404 Not Found</title>"
-            "<style>"
-            "body { font-family: Arial, sans-serif; text-align: center; padding-top: 50px; }"
-            "h1 { font-size: 48px; color: #cc0000; }"
-            "p  { font-size: 24px; color: #555; }"
-            "</style>"
-            "</head><body>"
-            "<h1>404 Not Found</h1>"
-            "</body></html>";
-        sendResponse(clientSock, "404 Not Found", "text/html", body);
-    } else {
-        string body((istreambuf_iterator<char>(ifs)), {});
+    vector<pair<string, string>> headers;
+
+    const string* header(const char* name) const {
+        for (const auto& h : headers)
+            if (equalsIgnoreCase(h.first, name)) return &h.second;
+        return nullptr;
+    }
+
+    // HTTP/1.1 тримає з'єднання за замовчуванням, HTTP/1.0 — лише на прохання.
+    bool keepAlive() const {
+        const string* c = header("Connection");
+        if (version == "HTTP/1.1") return !c || !containsToken(*c, "close");
+        return c && containsToken(*c, "keep-alive");
+    }
+};
+
+// Інкрементальний розбір запитів: байти додаються в міру надходження,
+// next() видає запити по одному. Запит може бути розірваний між кількома
+// recv, а один recv може містити кілька конвеєрних запитів.
+class HttpParser {
+public:
+    enum class Result { Incomplete, Ready, Bad };
+
+    void feed(const char* data, size_t n) { buf.append(data, n); }
+
+    Result next(HttpRequest& req) {
+        if (skipBody) {
+            size_t k = min(skipBody, buf.size() - pos);
+            pos += k;
+            skipBody -= k;
+            if (skipBody) return compact(), Result::Incomplete;
+        }
+        while (buf.compare(pos, 2, "\r\n") == 0) pos += 2;
+        size_t end = buf.find("\r\n\r\n", pos);
+        if (end == string::npos) {
+            compact();
+            return buf.size() > MAX_HEADER_BYTES ? Result::Bad : Result::Incomplete;
+        }
+        if (end - pos > MAX_HEADER_BYTES) return Result::Bad;
+
+        req = HttpRequest();
+        size_t lineEnd = buf.find("\r\n", pos);
+        istringstream line(buf.substr(pos, lineEnd - pos));
+        line >> req.method >> req.path >> req.version;
+        if (req.version.compare(0, 5, "HTTP/") != 0) return Result::Bad;
+
+        for (size_t at = lineEnd + 2; at < end + 2;) {
+            size_t eol = buf.find("\r\n", at);
+            size_t colon = buf.find(':', at);
+            if (colon == string::npos || colon > eol) return Result::Bad;
+            size_t v = buf.find_first_not_of(" \t", colon + 1);
+            size_t ve = buf.find_last_not_of(" \t", eol - 1);
+            req.headers.emplace_back(buf.substr(at, colon - at),
+                                     v < eol ? buf.substr(v, ve - v + 1) : string());
+            at = eol + 2;
+        }
+        pos = end + 4;
+
+        // Тіло запиту серверу не потрібне, але його треба пропустити,
+        // щоб не сплутати з наступним запитом.
+        if (req.header("Transfer-Encoding")) return Result::Bad;
+        if (const string* cl = req.header("Content-Length")) {
+            try {
+                skipBody = stoull(*cl);
+            } catch (const exception&) {
+                return Result::Bad;
+            }
+            size_t k = min(skipBody, buf.size() - pos);
+            pos += k;
+            skipBody -= k;
+        }
+        return Result::Ready;
+    }
+
+private:
+    void compact() {
+        buf.erase(0, pos);
+        pos = 0;
+    }
+
+    string buf;
+    size_t pos = 0;
+    size_t skipBody = 0;
+};
+
+// Готові HTTP-відповіді (заголовки + тіло) для файлів із PAGE_DIR.
+// Відповідь незмінна й спільна для всіх потоків, тож обслуговування
+// запиту — це пошук у таблиці й один send. Записи оновлюються, коли
+// файл змінюється на диску (inotify / FindFirstChangeNotification).
+class PageCache {
+public:
+    using Response = shared_ptr<const string>;
+
+    // Та сама відповідь із Connection: keep-alive і з Connection: close.
+    // Для великого файлу це лише заголовки, а тіло — у file.
+    struct Page {
+        Response keepAlive, close;
+        shared_ptr<const mapped_file> file;
+        string contentType;
+        size_t bodySize = 0;
+        bool rangeable = false;   // вміст файлу, можна віддавати частинами
+        string etag;
+        time_t modified = 0;
+        Response notModifiedKeepAlive, notModifiedClose;
+        // Стиснені варіанти в порядку переваги: {"br", ...}, {"gzip", ...}.
+        vector<pair<const char*, shared_ptr<const Page>>> encodings;
+
+        const Response& pick(bool keep) const { return keep ? keepAlive : close; }
+        const Response& notModified(bool keep) const { return keep ? notModifiedKeepAlive : notModifiedClose; }
+        const char* body() const {
+            return file ? file->data() : keepAlive->data() + keepAlive->size() - bodySize;
+        }
+        shared_ptr<const void> bodyOwner() const {
+            if (file) return file;
+            return keepAlive;
+        }
+    };
+
+    static Page buildPage(const string& status, const string& contentType, const string& body) {
+        Page p;
+        p.keepAlive = make_shared<const string>(buildResponse(status, contentType, body, true));
+        p.close = make_shared<const string>(buildResponse(status, contentType, body, false));
+        p.contentType = contentType;
+        p.bodySize = body.size();
+        return p;
+    }
+
+    PageCache(const string& dir): dir(dir) {
+        notFound = make_shared<const Page>(buildPage("404 Not Found", "text/html", NOT_FOUND_BODY));
+        notAllowed = buildPage("405 Method Not Allowed", "text/plain", "Method Not Allowed");
+        badRequest = buildPage("400 Bad Request", "text/plain", "Bad Request");
+        error_code ec;
+        for (const auto& e : filesystem::directory_iterator(dir, ec))
+            if (e.is_regular_file()) reload("/" + e.path().filename().string());
+    }
+
+    const Page& methodNotAllowed() const { return notAllowed; }
+    const Page& bad() const { return badRequest; }
+
+    // Сторінки незмінні й спільні для всіх потоків: запит коштує одне
+    // збільшення лічильника посилань, без копіювання заголовків і варіантів.
+    shared_ptr<const Page> get(const string& path) {
+        {
+            shared_lock<shared_mutex> lk(m);
+            auto it = entries.find(path);
+            if (it != entries.end()) return it->second;
+        }
+        // Файл міг з'явитися вже після запуску. Тут потік циклу подій, тож
+        // без стиснення: варіанти додасть watch(), коли дізнається про файл.
+        auto p = reload(path, false);
+        return p ? p : notFound;
+    }
+
+    // Перечитує файл; якщо його немає — прибирає запис і повертає nullptr.
+    // Без compress запис лише додається, але не замінює вже наявний.
+    shared_ptr<const Page> reload(const string& path, bool compress = true) {
+        if (path.find("..") != string::npos) return nullptr;
+        error_code ec;
+        uintmax_t size = filesystem::file_size(dir + path, ec);
+        ifstream ifs;
+        if (!ec && size < sendfileThreshold) ifs.open(dir + path, ios::binary);
+        if (ec || (size < sendfileThreshold && !ifs)) {
+            unique_lock<shared_mutex> lk(m);
+            entries.erase(path);
+            return nullptr;
+        }
         string ct = (path.find(".html") != string::npos)
                        ? "text/html"
                        : "application/octet-stream";
-        sendResponse(clientSock, "200 OK", ct, body);
+        struct stat st{};
+        stat((dir + path).c_str(), &st);
+        // Сильний ETag із розміру й часу зміни: змінюється разом із файлом.
+        char tag[64];
+        snprintf(tag, sizeof(tag), "\"%llx-%llx\"", static_cast<unsigned long long>(size),
+                 static_cast<unsigned long long>(st.st_mtime));
+        Page out;
+
+        if (size >= sendfileThreshold) {
+            shared_ptr<const mapped_file> file;
+            try {
+                file = make_shared<const mapped_file>(dir + path);
+            } catch (const exception&) {
+                unique_lock<shared_mutex> lk(m);
+                entries.erase(path);
+                return nullptr;
+            }
+            out = filePage(ct, nullptr, file, tag, st.st_mtime, "");
+        } else {
+            string body((istreambuf_iterator<char>(ifs)), {});
+            // Стиснені варіанти будуються один раз тут, а не на кожен запит.
+            vector<pair<const char*, string>> compressed;
+#ifdef LAB5_HAVE_BROTLI
+            if (compress) compressed.emplace_back("br", brotliCompress(body));
+#endif
+#ifdef LAB5_HAVE_GZIP
+            if (compress) compressed.emplace_back("gzip", gzipCompress(body));
+#endif
+            // Варіант має сенс, лише якщо помітно менший за оригінал.
+            compressed.erase(remove_if(compressed.begin(), compressed.end(), [&](const auto& c) {
+                return c.second.empty() || c.second.size() * 10 > body.size() * 9;
+            }), compressed.end());
+            string vary = compressed.empty() ? "" : "Vary: Accept-Encoding\r\n";
+            out = filePage(ct, &body, nullptr, tag, st.st_mtime, vary);
+            for (const auto& [name, data] : compressed) {
+                string etag = tag;
+                etag.insert(etag.size() - 1, string("-") + name);
+                out.encodings.emplace_back(name, make_shared<const Page>(
+                    filePage(ct, &data, nullptr, etag, st.st_mtime, vary + "Content-Encoding: " + name + "\r\n")));
+            }
+        }
+        auto page = make_shared<const Page>(move(out));
+        unique_lock<shared_mutex> lk(m);
+        if (!compress) return entries.emplace(path, page).first->second;
+        entries[path] = page;
+        return page;
+    }
+
+    // Сторінка вмісту файлу: тіло в body (повні відповіді) або в file
+    // (лише заголовки), а також готові відповіді 304 для умовних GET.
+    static Page filePage(const string& ct, const string* body, shared_ptr<const mapped_file> file,
+                         const string& etag, time_t modified, const string& extra) {
+        Page p;
+        p.contentType = ct;
+        p.rangeable = true;
+        p.etag = etag;
+        p.modified = modified;
+        string validators = "ETag: " + etag + "\r\nLast-Modified: " + httpDate(modified) + "\r\n";
+        string headers = ACCEPT_RANGES + validators + extra;
+        if (file) {
+            p.bodySize = file->size();
+            p.keepAlive = make_shared<const string>(buildHead("200 OK", ct, p.bodySize, true, headers));
+            p.close = make_shared<const string>(buildHead("200 OK", ct, p.bodySize, false, headers));
+            p.file = move(file);
+        } else {
+            p.bodySize = body->size();
+            p.keepAlive = make_shared<const string>(buildResponse("200 OK", ct, *body, true, headers));
+            p.close = make_shared<const string>(buildResponse("200 OK", ct, *body, false, headers));
+        }
+        string head304 = "HTTP/1.1 304 Not Modified\r\n" + validators + extra;
+        p.notModifiedKeepAlive = make_shared<const string>(head304 + "Connection: keep-alive\r\n\r\n");
+        p.notModifiedClose = make_shared<const string>(head304 + "Connection: close\r\n\r\n");
+        return p;
+    }
+
+    void reloadAll() {
+        vector<string> paths;
+        {
+            shared_lock<shared_mutex> lk(m);
+            for (const auto& e : entries) paths.push_back(e.first);
+        }
+        error_code ec;
+        for (const auto& e : filesystem::directory_iterator(dir, ec))
+            if (e.is_regular_file()) paths.push_back("/" + e.path().filename().string());
+        for (const auto& p : paths) reload(p);
+    }
+
+    // Потік, що стежить за каталогом і оновлює змінені файли.
+    void watch() {
+#ifdef __linux__
+        int fd = inotify_init1(IN_CLOEXEC);
+        if (fd < 0 || inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+            cerr << "inotify failed, cache will not be refreshed\n";
+            return;
+        }
+        thread([this, fd] {
+            alignas(inotify_event) char buf[4096];
+            while (true) {
+                ssize_t n = read(fd, buf, sizeof(buf));
+                if (n <= 0) {
+                    if (n < 0 && errno == EINTR) continue;
+                    break;
+                }
+                for (char* p = buf; p < buf + n;) {
+                    auto* ev = reinterpret_cast<inotify_event*>(p);
+                    if (ev->len) reload(string("/") + ev->name);
+                    p += sizeof(inotify_event) + ev->len;
+                }
+            }
+        }).detach();
+#elif defined(_WIN32)
+        HANDLE h = FindFirstChangeNotificationA(dir.c_str(), FALSE,
+                                                FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+        if (h == INVALID_HANDLE_VALUE) {
+            cerr << "FindFirstChangeNotification failed, cache will not be refreshed\n";
+            return;
+        }
+        // Windows не каже, який файл змінився, тож перечитується весь каталог.
+        thread([this, h] {
+            while (WaitForSingleObject(h, INFINITE) == WAIT_OBJECT_0) {
+                reloadAll();
+                if (!FindNextChangeNotification(h)) break;
+            }
+            FindCloseChangeNotification(h);
+        }).detach();
+#endif
+    }
+
+private:
+    static inline const string ACCEPT_RANGES = "Accept-Ranges: bytes\r\n";
+    static constexpr const char* NOT_FOUND_BODY =
+        "<!DOCTYPE html>"
+        "<html><head><meta charset=\"utf-8\">"
+        "<title>404 Not Found</title>"
+        "<style>"
+        "body { font-family: Arial, sans-serif; text-align: center; padding-top: 50px; }"
+        "h1 { font-size: 48px; color: #cc0000; }"
+        "p  { font-size: 24px; color: #555; }"
+        "</style>"
+        "</head><body>"
+        "<h1>404 Not Found</h1>"
+        "</body></html>";
+
+    string dir;
+    shared_mutex m;
+    unordered_map<string, shared_ptr<const Page>> entries;
+    shared_ptr<const Page> notFound;
+    Page notAllowed, badRequest;
+};
+
+enum class RangeResult { Ignore, Ok, Unsatisfiable };
+
+// Один діапазон "bytes=a-b", "bytes=a-" або "bytes=-n" (RFC 7233).
+// Кілька діапазонів чи незрозумілий запис ігноруються — тоді віддається
+// весь файл, як дозволяє стандарт.
+RangeResult parseRange(const string& value, size_t size, size_t& from, size_t& to) {
+    if (value.compare(0, 6, "bytes=") != 0 || value.find(',') != string::npos) return RangeResult::Ignore;
+    size_t dash = value.find('-', 6);
+    if (dash == string::npos) return RangeResult::Ignore;
+    string a = value.substr(6, dash - 6), b = value.substr(dash + 1);
+    auto number = [](const string& t, size_t& v) {
+        if (t.empty() || t.find_first_not_of("0123456789") != string::npos || t.size() > 18) return false;
+        v = stoull(t);
+        return true;
+    };
+    size_t x, y;
+    if (a.empty()) {
+        if (!number(b, y)) return RangeResult::Ignore;
+        if (y == 0 || size == 0) return RangeResult::Unsatisfiable;
+        from = size - min(y, size);
+        to = size - 1;
+        return RangeResult::Ok;
+    }
+    if (!number(a, x)) return RangeResult::Ignore;
+    if (b.empty()) y = SIZE_MAX;
+    else if (!number(b, y) || y < x) return RangeResult::Ignore;
+    if (x >= size) return RangeResult::Unsatisfiable;
+    from = x;
+    to = min(y, size - 1);
+    return RangeResult::Ok;
+}
+
+// Шматок вихідної черги: готові байти або діапазон відображеного файлу.
+// owner тримає пам'ять живою, поки шматок не відправлено.
+struct OutChunk {
+    shared_ptr<const void> owner;
+    const char* data;
+    size_t size;
+    const mapped_file* file = nullptr;
+};
+
+// Стан HTTP-з'єднання без прив'язки до способу вводу-виводу: драйвер
+// передає прийняті байти в received(), а готові відповіді забирає з
+// черги через gather()/sent(). Відповіді — спільні байти з кешу або
+// відображені файли, без копій.
+class HttpConnection {
+public:
+    explicit HttpConnection(PageCache* cache): cache(cache) {}
+
+    void received(const char* data, size_t n) {
+        if (closing) return;
+        parser.feed(data, n);
+        HttpRequest req;
+        while (!closing) {
+            auto r = parser.next(req);
+            if (r == HttpParser::Result::Incomplete) break;
+            if (r == HttpParser::Result::Bad) {
+                respond(req, cache->bad(), false);
+                break;
+            }
+            bool keep = req.keepAlive() && ++served < MAX_REQUESTS_PER_CONNECTION;
+            if (req.method != "GET") {
+                respond(req, cache->methodNotAllowed(), keep);
+            } else {
+                if (req.path == "/") req.path = "/home.html";
+                respond(req, *cache->get(req.path), keep);
+            }
+        }
+    }
+
+    // Буфери ще не відправлених відповідей, по порядку. Якщо untilFile,
+    // зупиняється перед першим шматком файлу (його відправить sendfile).
+    void gather(vector<net_buffer>& bufs, bool untilFile = false) const {
+        bufs.clear();
+        size_t skip = outOffset;
+        for (const auto& c : out) {
+            if (untilFile && c.file) break;
+            bufs.push_back({c.data + skip, c.size - skip});
+            skip = 0;
+        }
+    }
+
+    // Якщо першим у черзі стоїть шматок файлу — його залишок.
+    const mapped_file* frontFile(size_t& offset, size_t& length) const {
+        if (out.empty() || !out.front().file) return nullptr;
+        const OutChunk& c = out.front();
+        offset = static_cast<size_t>(c.data - c.file->data()) + outOffset;
+        length = c.size - outOffset;
+        return c.file;
+    }
+
+    void sent(size_t n) {
+        while (n && !out.empty()) {
+            size_t left = out.front().size - outOffset;
+            if (n < left) {
+                outOffset += n;
+                return;
+            }
+            n -= left;
+            out.pop_front();
+            outOffset = 0;
+        }
+    }
+
+    bool hasOutput() const { return !out.empty(); }
+    size_t queued() const { return out.size(); }
+    // Після відповіді з Connection: close нових запитів не приймаємо.
+    bool finished() const { return closing && out.empty(); }
+
+private:
+    // Умовний GET: If-None-Match має перевагу над If-Modified-Since (RFC 7232).
+    static bool notModified(const HttpRequest& req, const PageCache::Page& page) {
+        if (const string* inm = req.header("If-None-Match")) {
+            size_t pos = 0;
+            while (pos < inm->size()) {
+                size_t comma = inm->find(',', pos);
+                string tag = trim(inm->substr(pos, comma == string::npos ? string::npos : comma - pos));
+                if (tag.compare(0, 2, "W/") == 0) tag = tag.substr(2);
+                if (tag == "*" || tag == page.etag) return true;
+                if (comma == string::npos) break;
+                pos = comma + 1;
+            }
+            return false;
+        }
+        // Не змінено, якщо файл не новіший за дату із запиту; дата з
+        // майбутнього чи нерозбірлива ігнорується (RFC 7232, 3.3).
+        const string* ims = req.header("If-Modified-Since");
+        time_t since;
+        return ims && parseHttpDate(*ims, since) && since <= time(nullptr) && page.modified <= since;
     }
 
+    void respond(const HttpRequest& req, const PageCache::Page& original, bool keep) {
+        if (!keep) closing = true;
+        const PageCache::Page* chosen = &original;
+        const string* ae = original.encodings.empty() ? nullptr : req.header("Accept-Encoding");
+        if (ae) {
+            for (const auto& [name, variant] : original.encodings) {
+                if (acceptsEncoding(*ae, name)) {
+                    chosen = variant.get();
+                    break;
+                }
+            }
+        }
+        const PageCache::Page& page = *chosen;
+        if (page.rangeable && notModified(req, page)) {
+            push(page.notModified(keep));
+            return;
+        }
+        const string* range = page.rangeable ? req.header("Range") : nullptr;
+        size_t from = 0, to = 0;
+        RangeResult rr = range ? parseRange(*range, page.bodySize, from, to) : RangeResult::Ignore;
+        if (rr == RangeResult::Unsatisfiable) {
+            push(make_shared<const string>(buildResponse("416 Range Not Satisfiable", "text/plain", "", keep,
+                                                         "Content-Range: bytes */" + to_string(page.bodySize) + "\r\n")));
+            return;
+        }
+        if (rr == RangeResult::Ok) {
+            push(make_shared<const string>(buildHead("206 Partial Content", page.contentType, to - from + 1, keep,
+                                                     "Content-Range: bytes " + to_string(from) + "-" + to_string(to) +
+                                                     "/" + to_string(page.bodySize) + "\r\n")));
+            out.push_back({page.bodyOwner(), page.body() + from, to - from + 1, page.file.get()});
+            return;
+        }
+        push(page.pick(keep));
+        if (page.file && page.bodySize)
+            out.push_back({page.file, page.file->data(), page.bodySize, page.file.get()});
+    }
+
+    void push(const PageCache::Response& r) {
+        out.push_back({r, r->data(), r->size(), nullptr});
+    }
+
+    PageCache* cache;
+    HttpParser parser;
+    size_t served = 0;
+    bool closing = false;
+    deque<OutChunk> out;
+    size_t outOffset = 0;
+};
+
+// Потік на з'єднання: блокуючий recv з тайм-аутом простою.
+void handleClient(SOCKET clientSock, PageCache* cache) {
+    set_recv_timeout(clientSock, IDLE_TIMEOUT);
+    HttpConnection conn(cache);
+    vector<net_buffer> bufs;
+    char buffer[4096];
+    while (!conn.finished()) {
+        int bytes = recv(clientSock, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) break;
+        conn.received(buffer, bytes);
+        if (conn.hasOutput()) {
+            conn.gather(bufs);
+            if (!send_gather(clientSock, bufs.data(), bufs.size())) break;
+            conn.sent(SIZE_MAX);
+        }
+    }
     closesocket(clientSock);
 }
 
-int main() {
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
+#ifdef __linux__
+// Цикл подій на потік: власний слухаючий сокет із SO_REUSEPORT (ядро
+// розподіляє нові з'єднання між потоками), власний epoll у режимі
+// edge-triggered і неблокуючі HttpConnection. Кількість потоків не
+// залежить від кількості з'єднань.
+class EventLoop {
+public:
+    EventLoop(PageCache* cache, uint16_t port): cache(cache) {
+        listenSock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        if (listenSock == INVALID_SOCKET) throw runtime_error("socket() failed");
+        int opt = 1;
+        setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        setsockopt(listenSock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = INADDR_ANY;
+        if (::bind(listenSock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) throw runtime_error("bind() failed");
+        if (listen(listenSock, SOMAXCONN) == SOCKET_ERROR) throw runtime_error("listen() failed");
+
+        ep = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u64 = LISTEN_TAG;
+        if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, listenSock, &ev) != 0) throw runtime_error("epoll failed");
+    }
+
+    void run() {
+        epoll_event events[512];
+        while (true) {
+            int n = epoll_wait(ep, events, 512, 1000);
+            if (n < 0 && errno != EINTR) {
+                cerr << "epoll_wait() failed\n";
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.u64 == LISTEN_TAG) {
+                    acceptAll();
+                    continue;
+                }
+                auto it = conns.find(events[i].data.u64);
+                if (it == conns.end()) continue;
+                Client* c = it->second.get();
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    close(c);
+                    continue;
+                }
+                touch(c);
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP)) readAll(c);
+                else if ((events[i].events & EPOLLOUT) && flush(c) && c->readPaused) readAll(c);
+            }
+            expireIdle();
+        }
+    }
+
+private:
+    static constexpr uint64_t LISTEN_TAG = ~uint64_t(0);
+    // Поки стільки відповідей чекають на відправку, нові запити не читаються.
+    static constexpr size_t MAX_QUEUED = 64;
+
+    struct Client {
+        Client(SOCKET s, uint64_t id, PageCache* cache): sock(s), id(id), conn(cache) {}
+        SOCKET sock;
+        uint64_t id;
+        HttpConnection conn;
+        bool readPaused = false;
+        chrono::steady_clock::time_point lastActive;
+        list<Client*>::iterator lru;
+    };
+
+    void acceptAll() {
+        while (true) {
+            SOCKET s = accept4(listenSock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (s == INVALID_SOCKET) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (!net_would_block()) cerr << "accept() failed: " << errno << "\n";
+                return;
+            }
+            int one = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            auto c = make_unique<Client>(s, nextId++, cache);
+            c->lastActive = chrono::steady_clock::now();
+            c->lru = idle.insert(idle.end(), c.get());
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.u64 = c->id;
+            epoll_ctl(ep, EPOLL_CTL_ADD, s, &ev);
+            conns.emplace(c->id, move(c));
+        }
+    }
+
+    // Edge-triggered: читаємо, доки сокет не порожній, інакше нової
+    // події про ці дані вже не буде. Якщо читання зупинено через повну
+    // чергу відповідей, воно продовжується, щойно черга відправлена.
+    void readAll(Client* c) {
+        char buf[16384];
+        do {
+            c->readPaused = false;
+            while (!c->conn.finished()) {
+                if (c->conn.queued() >= MAX_QUEUED) {
+                    c->readPaused = true;
+                    break;
+                }
+                ssize_t n = recv(c->sock, buf, sizeof(buf), 0);
+                if (n > 0) {
+                    c->conn.received(buf, static_cast<size_t>(n));
+                } else if (n == 0) {
+                    // Клієнт закрив свій бік: дописуємо, що встигли, й закриваємо.
+                    if (flush(c)) close(c);
+                    return;
+                } else if (errno != EINTR) {
+                    if (!net_would_block()) return close(c);
+                    break;
+                }
+            }
+        } while (flush(c) && c->readPaused);
+    }
+
+    // true, якщо все відправлено й з'єднання лишається відкритим.
+    bool flush(Client* c) {
+        while (c->conn.hasOutput()) {
+            size_t offset, length;
+            if (const mapped_file* f = c->conn.frontFile(offset, length)) {
+                // Тіло великого файлу йде з кешу сторінок ядра напряму в сокет.
+                off_t off = static_cast<off_t>(offset);
+                ssize_t n = sendfile(c->sock, f->native_handle(), &off, length);
+                if (n > 0) {
+                    c->conn.sent(static_cast<size_t>(n));
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && net_would_block()) return false;
+                // 0 — файл укоротили під час відправки; відповідь уже не завершити.
+                close(c);
+                return false;
+            }
+            c->conn.gather(bufs, true);
+            size_t k = min<size_t>(bufs.size(), 64);
+            iovec iov[64];
+            for (size_t i = 0; i < k; ++i) iov[i] = {const_cast<char*>(bufs[i].data), bufs[i].size};
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = k;
+            ssize_t n = sendmsg(c->sock, &msg, MSG_NOSIGNAL);
+            if (n >= 0) {
+                c->conn.sent(static_cast<size_t>(n));
+            } else if (errno != EINTR) {
+                // EAGAIN: допишемо за наступною подією EPOLLOUT.
+                if (!net_would_block()) close(c);
+                return false;
+            }
+        }
+        if (c->conn.finished()) {
+            close(c);
+            return false;
+        }
+        return true;
+    }
+
+    void touch(Client* c) {
+        c->lastActive = chrono::steady_clock::now();
+        idle.splice(idle.end(), idle, c->lru);
+    }
+
+    // Список упорядкований за останньою активністю, тож перевіряється лише голова.
+    void expireIdle() {
+        auto deadline = chrono::steady_clock::now() - IDLE_TIMEOUT;
+        while (!idle.empty() && idle.front()->lastActive < deadline) close(idle.front());
+    }
+
+    void close(Client* c) {
+        epoll_ctl(ep, EPOLL_CTL_DEL, c->sock, nullptr);
+        closesocket(c->sock);
+        idle.erase(c->lru);
+        conns.erase(c->id);
+    }
+
+    PageCache* cache;
+    SOCKET listenSock;
+    int ep;
+    uint64_t nextId = 0;
+    unordered_map<uint64_t, unique_ptr<Client>> conns;
+    list<Client*> idle;
+    vector<net_buffer> bufs;
+};
+
+// Без цього кожен процес обмежений ~1024 дескрипторами.
+void raiseFileLimit() {
+    rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    size_t loops = max(1u, thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) loops = stoul(argv[++i]);
+        else if (arg == "--sendfile-threshold" && i + 1 < argc) sendfileThreshold = stoull(argv[++i]);
+    }
+
+    unique_ptr<socket_runtime> net;
+    try {
+        net = make_unique<socket_runtime>();
+    } catch (const exception&) {
         cerr << "WSAStartup failed\n";
         return 1;
     }
 
+    PageCache cache(PAGE_DIR);
+    cache.watch();
+
+#ifdef __linux__
+    raiseFileLimit();
+    try {
+        vector<unique_ptr<EventLoop>> eventLoops;
+        for (size_t i = 0; i < loops; ++i) eventLoops.push_back(make_unique<EventLoop>(&cache, PORT));
+        cout << "Listening on port " << PORT << " with " << loops << " event loops...\n";
+        vector<thread> threads;
+        for (auto& l : eventLoops) threads.emplace_back(&EventLoop::run, l.get());
+        for (auto& t : threads) t.join();
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+#else
     SOCKET listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (listenSock == INVALID_SOCKET) {
         cerr << "socket() failed\n";
-        WSACleanup();
         return 1;
     }
 
     sockaddr_in serverAddr{};
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_port = htons(PORT);
-    serverAddr.sin_addr.S_un.S_addr = INADDR_ANY;
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
 
     int opt = 1;
     setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
 
-    if (bind(listenSock, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+    if (::bind(listenSock, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
         cerr << "bind() failed\n";
         closesocket(listenSock);
-        WSACleanup();
         return 1;
     }
 
     if (listen(listenSock, SOMAXCONN) == SOCKET_ERROR) {
         cerr << "listen() failed\n";
         closesocket(listenSock);
-        WSACleanup();
         return 1;
     }
 
     cout << "Listening on port " << PORT << "...\n";
     while (true) {
         sockaddr_in clientAddr;
-        int addrLen = sizeof(clientAddr);
+        socklen_t addrLen = sizeof(clientAddr);
 
         SOCKET clientSock = accept(listenSock, (sockaddr*)&clientAddr, &addrLen);
         if (clientSock == INVALID_SOCKET) {
@@ -119,10 +960,10 @@ int main() {
             continue;
         }
 
-        thread(handleClient, clientSock).detach();
+        thread(handleClient, clientSock, &cache).detach();
     }
 
     closesocket(listenSock);
-    WSACleanup();
+#endif
     return 0;
-}
\ No newline at end of file
+}